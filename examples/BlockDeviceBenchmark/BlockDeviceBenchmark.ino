@@ -0,0 +1,89 @@
+/*
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+  |                                      BlockDeviceBenchmark.ino                                       |
+  |                                       SPIFlash library v 3.1.0                                       |
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+  |                                               Marzogh                                                |
+  |                                              18.10.2026                                              |
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+  |                                                                                                      |
+  |  Compares the throughput of FlashBlockDevice with plain SPIFlash calls for the access pattern of a   |
+  |  filesystem - small programs one after the other and small reads close to each other. The same       |
+  |  data is written and read back both ways and the time taken and the throughput are printed.          |
+  |  To mount littlefs on the block device include lfs.h before FlashBlockDevice.h and pass the          |
+  |  configuration filled in by lfsConfig() to lfs_format() / lfs_mount().                               |
+  |                                                                                                      |
+  |  WARNING: Erases the first 2 x TESTSIZE bytes of the flash memory.                                   |
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+*/
+
+#include <SPIFlash.h>
+#include <FlashBlockDevice.h>
+
+#define TESTSIZE  KB(32)
+#define CHUNK     16
+
+SPIFlash flash(CS);
+// The block device gathers small programs in a page sized program cache and serves small reads from a 64 byte read cache
+uint8_t readCache[64], progCache[SPI_PAGESIZE];
+FlashBlockDevice bd(flash, TESTSIZE, TESTSIZE, readCache, sizeof(readCache), progCache, sizeof(progCache));
+
+void printResult(const char *name, uint32_t time) {
+  Serial.print(name);
+  Serial.print(time / 1000);
+  Serial.print(F(" ms, "));
+  Serial.print((float)TESTSIZE * 1000000 / 1024 / time);
+  Serial.println(F(" KB/s"));
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) ; // Wait for Serial monitor to open
+  flash.begin();
+
+  Serial.println(F("Erasing test area..."));
+  flash.eraseSection(0, 2 * TESTSIZE);
+
+  uint8_t data[CHUNK], check[CHUNK];
+  uint16_t errors = 0;
+  for (uint8_t i = 0; i < CHUNK; i++) {
+    data[i] = i;
+  }
+
+  // Plain SPIFlash calls
+  uint32_t start = micros();
+  for (uint32_t addr = 0; addr < TESTSIZE; addr += CHUNK) {
+    flash.writeByteArray(addr, data, CHUNK);
+  }
+  printResult("writeByteArray():      ", micros() - start);
+
+  start = micros();
+  for (uint32_t addr = 0; addr < TESTSIZE; addr += CHUNK) {
+    flash.readByteArray(addr, check, CHUNK);
+  }
+  printResult("readByteArray():       ", micros() - start);
+
+  // Block device
+  start = micros();
+  for (uint32_t addr = 0; addr < TESTSIZE; addr += CHUNK) {
+    bd.prog(addr / BD_BLOCKSIZE, addr % BD_BLOCKSIZE, data, CHUNK);
+  }
+  bd.sync();
+  printResult("FlashBlockDevice prog: ", micros() - start);
+
+  start = micros();
+  for (uint32_t addr = 0; addr < TESTSIZE; addr += CHUNK) {
+    bd.read(addr / BD_BLOCKSIZE, addr % BD_BLOCKSIZE, check, CHUNK);
+    if (memcmp(data, check, CHUNK)) {
+      errors++;
+    }
+  }
+  printResult("FlashBlockDevice read: ", micros() - start);
+
+  Serial.print(F("Mismatches: "));
+  Serial.println(errors);
+}
+
+void loop() {
+
+}
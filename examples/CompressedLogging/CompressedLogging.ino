@@ -0,0 +1,122 @@
+/*
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+  |                                        CompressedLogging.ino                                         |
+  |                                       SPIFlash library v 3.1.0                                       |
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+  |                                               Marzogh                                                |
+  |                                              18.10.2026                                              |
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+  |                                                                                                      |
+  |  Benchmarks CompressedFlash against a plain FlashWriter on a telemetry log. The same CSV lines -     |
+  |  timestamp, temperature, pressure, humidity and a status word, as a typical sensor node logs them -  |
+  |  are written through both and the time taken, the bytes programmed and the compression ratio are    |
+  |  printed, followed by a random read test on the compressed copy.                                    |
+  |                                                                                                      |
+  |  WARNING: Erases the first 2 x LOGSIZE bytes of the flash memory.                                    |
+  |~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~|
+*/
+
+#include <SPIFlash.h>
+#include <FlashWriter.h>
+#include <CompressedFlash.h>
+
+#define LOGSIZE   KB(64)
+#define NUMLINES  1000
+
+SPIFlash flash(CS);
+
+uint32_t timestamp;
+int32_t  temperature, pressure, humidity;
+
+// Produces the next line of telemetry. Readings drift slowly, like those of a real sensor.
+uint8_t nextLine(char *line) {
+  timestamp += 10;
+  temperature += random(-3, 4);
+  pressure += random(-1, 2);
+  humidity += random(-2, 3);
+  return sprintf(line, "%lu,%ld.%02ld,%ld,%ld.%ld,OK\n", (unsigned long)timestamp, (long)(temperature / 100), (long)abs(temperature % 100),
+                 (long)pressure, (long)(humidity / 10), (long)abs(humidity % 10));
+}
+
+void resetReadings() {
+  randomSeed(42);
+  timestamp = 1700000000UL;
+  temperature = 2150;
+  pressure = 101325;
+  humidity = 455;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) ; // Wait for Serial monitor to open
+  flash.begin();
+
+  Serial.println(F("Erasing log area..."));
+  flash.eraseSection(0, 2 * LOGSIZE);
+
+  char line[64];
+  uint32_t rawBytes = 0;
+
+  // Plain page-buffered log
+  FlashWriter raw(flash, 0, LOGSIZE, false);
+  resetReadings();
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < NUMLINES; i++) {
+    uint8_t len = nextLine(line);
+    raw.write((uint8_t*)line, len);
+    rawBytes += len;
+  }
+  raw.flush();
+  uint32_t rawTime = micros() - start;
+
+  // Compressed log
+  CompressedFlash packed(flash, LOGSIZE, LOGSIZE, false);
+  packed.begin();
+  resetReadings();
+  start = micros();
+  for (uint16_t i = 0; i < NUMLINES; i++) {
+    uint8_t len = nextLine(line);
+    packed.write((uint8_t*)line, len);
+  }
+  packed.flush();
+  uint32_t packedTime = micros() - start;
+
+  Serial.print(F("Logged "));
+  Serial.print(rawBytes);
+  Serial.print(F(" bytes in "));
+  Serial.print(NUMLINES);
+  Serial.println(F(" lines"));
+  Serial.print(F("FlashWriter:     "));
+  Serial.print(raw.position());
+  Serial.print(F(" bytes programmed in "));
+  Serial.print(rawTime / 1000);
+  Serial.println(F(" ms"));
+  Serial.print(F("CompressedFlash: "));
+  Serial.print(packed.used());
+  Serial.print(F(" bytes programmed in "));
+  Serial.print(packedTime / 1000);
+  Serial.println(F(" ms"));
+  Serial.print(F("Compression ratio: "));
+  Serial.println(packed.ratio());
+
+  // Read random slices of the compressed log back and compare them with the plain copy
+  uint8_t a[48], b[48];
+  uint16_t errors = 0;
+  start = micros();
+  for (uint8_t i = 0; i < 100; i++) {
+    uint32_t offset = random(rawBytes - sizeof(a));
+    packed.read(offset, a, sizeof(a));
+    flash.readByteArray(offset, b, sizeof(b));
+    if (memcmp(a, b, sizeof(a))) {
+      errors++;
+    }
+  }
+  Serial.print(F("100 random reads took "));
+  Serial.print((micros() - start) / 1000);
+  Serial.print(F(" ms, mismatches: "));
+  Serial.println(errors);
+}
+
+void loop() {
+
+}
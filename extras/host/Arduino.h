@@ -0,0 +1,170 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Minimal Arduino core for building the library on a Linux host. Only the parts of the core that
+// the library and its host tools use are provided. Serial writes to stderr so that the diagnostic
+// messages printed by the library do not get mixed into the output of a host tool.
+// Time is virtual - micros() and millis() only move on when the flash bus is used or delay() is called.
+// See HostFlash.h for the flash chip that sits behind SPI on the host.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+#define ARDUINO_ARCH_HOST
+
+typedef uint8_t  byte;
+typedef bool     boolean;
+typedef uint16_t word;
+
+#define HIGH    0x1
+#define LOW     0x0
+#define INPUT   0x0
+#define OUTPUT  0x1
+#define DEC     10
+#define HEX     16
+#define OCT     8
+#define BIN     2
+#define SS      10
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                      Time, pins and interrupts                     //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+uint32_t micros();
+uint32_t millis();
+void     delay(uint32_t ms);
+void     delayMicroseconds(uint32_t us);
+void     yield();
+// Host only - the virtual clock behind micros() and millis(), in nanoseconds
+uint64_t hostNanos();
+void     hostAdvance(uint64_t ns);
+void     pinMode(uint8_t pin, uint8_t mode);
+void     digitalWrite(uint8_t pin, uint8_t val);
+int      digitalRead(uint8_t pin);
+inline void interrupts() {}
+inline void noInterrupts() {}
+
+long     random(long howbig);
+long     random(long howsmall, long howbig);
+void     randomSeed(unsigned long seed);
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                              Strings                               //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// There is no separate program memory on the host - F() strings are ordinary strings
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String {
+public:
+  String(const char *cstr = "") : _s(cstr ? cstr : "") {}
+  String(const std::string &s) : _s(s) {}
+  unsigned int length() const { return _s.length(); }
+  const char *c_str() const { return _s.c_str(); }
+  bool     reserve(unsigned int size) { _s.reserve(size); return true; }
+  bool     concat(char c) { _s += c; return true; }
+  bool     concat(const char *cstr) { _s += cstr; return true; }
+  bool     concat(const String &str) { _s += str._s; return true; }
+  String & operator += (char c) { concat(c); return *this; }
+  String & operator += (const char *cstr) { concat(cstr); return *this; }
+  String & operator += (const String &str) { concat(str); return *this; }
+  bool     operator == (const String &str) const { return _s == str._s; }
+  bool     operator != (const String &str) const { return _s != str._s; }
+  char     operator [] (unsigned int index) const { return index < _s.length() ? _s[index] : 0; }
+  void     toCharArray(char *buf, unsigned int bufsize) const {
+    if (bufsize) {
+      strncpy(buf, _s.c_str(), bufsize - 1);
+      buf[bufsize - 1] = 0;
+    }
+  }
+private:
+  std::string _s;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                           Print & Stream                           //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t   write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  virtual void flush() {}
+  int      getWriteError() { return _writeError; }
+  void     clearWriteError() { _writeError = 0; }
+
+  size_t   print(const __FlashStringHelper *str) { return write((const char *)str); }
+  size_t   print(const String &str) { return write(str.c_str()); }
+  size_t   print(const char *str) { return write(str); }
+  size_t   print(char c) { return write((uint8_t)c); }
+  size_t   print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t   print(int n, int base = DEC) { return print((long)n, base); }
+  size_t   print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t   print(long n, int base = DEC);
+  size_t   print(unsigned long n, int base = DEC);
+  size_t   print(double n, int digits = 2);
+
+  size_t   println() { return write("\r\n"); }
+  template <class T> size_t println(const T &value) { size_t n = print(value); return n + println(); }
+  template <class T> size_t println(const T &value, int format) { size_t n = print(value, format); return n + println(); }
+
+protected:
+  void     setWriteError(int err = 1) { _writeError = err; }
+
+private:
+  int      _writeError = 0;
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+public:
+  void     begin(unsigned long baud) {}
+  void     end() {}
+  size_t   write(uint8_t c) { return fputc(c, stderr) == EOF ? 0 : 1; }
+  size_t   write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, stderr); }
+  using    Print::write;
+  void     flush() { fflush(stderr); }
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_ARDUINO_H
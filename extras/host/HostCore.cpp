@@ -0,0 +1,162 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "HostFlash.h"
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+// Virtual time in nanoseconds. The flash bus, delay() and delayMicroseconds() move it on - nothing
+// actually waits, so code that waits on the flash does not slow host programs down
+static uint64_t _nowNs = 0;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                      Time, pins and interrupts                     //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+uint64_t hostNanos() {
+  return _nowNs;
+}
+
+void hostAdvance(uint64_t ns) {
+  _nowNs += ns;
+}
+
+uint32_t micros() {
+  return (uint32_t)(_nowNs / 1000);
+}
+
+uint32_t millis() {
+  return (uint32_t)(_nowNs / 1000000);
+}
+
+void delay(uint32_t ms) {
+  _nowNs += (uint64_t)ms * 1000000;
+}
+
+void delayMicroseconds(uint32_t us) {
+  _nowNs += (uint64_t)us * 1000;
+}
+
+// Lets busy loops that poll the clock without touching the bus make progress
+void yield() {
+  _nowNs += 1000;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  HostFlash::pinWrite(pin, val);
+}
+
+int digitalRead(uint8_t pin) {
+  return LOW;
+}
+
+long random(long howbig) {
+  return howbig ? rand() % howbig : 0;
+}
+
+long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed) {
+    srand(seed);
+  }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                               Print                                //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buffer++)) {
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+
+size_t Print::print(long n, int base) {
+  if (base == DEC) {
+    char _buf[24];
+    snprintf(_buf, sizeof(_buf), "%ld", n);
+    return write(_buf);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char _buf[8 * sizeof(long) + 1];
+  char *_str = &_buf[sizeof(_buf) - 1];
+  *_str = '\0';
+  if (base < 2) {
+    base = DEC;
+  }
+  do {
+    char c = n % base;
+    n /= base;
+    *--_str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(_str);
+}
+
+size_t Print::print(double n, int digits) {
+  char _buf[64];
+  snprintf(_buf, sizeof(_buf), "%.*f", digits, n);
+  return write(_buf);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                                SPI                                 //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+void SPIClass::beginTransaction(SPISettings settings) {
+  HostFlash::setClock(settings.clock);
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  return HostFlash::transfer(data);
+}
+
+uint16_t SPIClass::transfer16(uint16_t data) {
+  uint16_t _hi = transfer(data >> 8);
+  return (_hi << 8) | transfer(data & 0xFF);
+}
+
+void SPIClass::transfer(void *buf, size_t count) {
+  uint8_t *_buf = (uint8_t *)buf;
+  while (count--) {
+    *_buf = transfer(*_buf);
+    _buf++;
+  }
+}
@@ -0,0 +1,647 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "HostFlash.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HOSTFLASH_DEVICEID        0x13      // Returned by JEDEC_READ_MANSIG and JEDEC_SET_RELEASE
+#define HOSTFLASH_TRANSACTIONNS   1000      // Default time taken to select and deselect the chip around a command
+
+//                                          name           manufacturerID   memoryTypeID     capID  capacity  maxClock   maxReadClock tBP   tPP   tSE    tBE32   tBE64   tCE       tSUS  suspend resume
+const HostFlashProfile hostFlashInstant = { "Instant",     WINBOND_MANID,   0x40,            0x00,  MB(8),    0,         0,           0,    0,    0,     0,      0,      0,        0,    0x75,   0x7A };
+const HostFlashProfile hostFlashW25Q64  = { "W25Q64JV",    WINBOND_MANID,   0x40,            0x00,  MB(8),    133000000, 50000000,    30,   400,  45000, 120000, 150000, 20000000, 20,   0x75,   0x7A };
+const HostFlashProfile hostFlashSST26   = { "SST26VF064B", MICROCHIP_MANID, MICROCHIP_SST26, 0x43,  MB(8),    104000000, 40000000,    1500, 1500, 18000, 18000,  18000,  35000,    10,   0xB0,   0x30 };
+const HostFlashProfile hostFlashS25FL   = { "S25FL116K",   CYPRESS_MANID,   0x40,            0x00,  MB(2),    108000000, 50000000,    30,   700,  60000, 150000, 250000, 6000000,  20,   0x75,   0x7A };
+
+HostFlash *HostFlash::_chips[HOSTFLASH_MAXCHIPS];
+HostFlash *HostFlash::_selected = NULL;
+uint32_t HostFlash::_clock = SPI_CLK;
+uint32_t HostFlash::_transactionNs = HOSTFLASH_TRANSACTIONNS;
+uint32_t HostFlash::_byteNs = 0;
+
+// Constructor
+//  Takes two arguments -
+//    1. cs --> The chip select pin the chip is attached to. Pass the same pin to the SPIFlash constructor
+//    2. profile --> The part to emulate. Defaults to hostFlashInstant
+HostFlash::HostFlash(uint8_t cs, const HostFlashProfile &profile) {
+  _cs = cs;
+  _profile = &profile;
+  _fd = -1;
+  _mem = NULL;
+  _capacity = 0;
+  _opcode = _lastOut = 0;
+  _deselectNs = 0;
+  _wel = _fourByte = _poweredDown = _locked = false;
+  _busyUntil = _remainNs = 0;
+  _busyOp = _suspendedOp = 0;
+  resetStats();
+}
+
+HostFlash::~HostFlash() {
+  close();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                             Image file                             //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Maps an image file and attaches the chip to the SPI bus. A file that does not exist - or is shorter than
+// capacity - is extended with erased (0xFF) bytes. Returns false if the file cannot be mapped, if
+// HOSTFLASH_MAXCHIPS chips are already attached or if the capacity does not suit the profile - it must be
+// a power of two from 64 KB to 32 MB, or exactly the profile's capacity if the profile has a fixed capacity ID.
+//  Takes two arguments -
+//    1. path --> Path of the image file
+//    2. capacity --> Capacity of the chip in bytes. Defaults to the size of an existing file, or the
+//                    capacity in the profile for a new one
+bool HostFlash::open(const char *path, uint32_t capacity) {
+  close();
+  uint8_t _slot = 0;
+  while (_slot < HOSTFLASH_MAXCHIPS && _chips[_slot]) {
+    _slot++;
+  }
+  if (_slot == HOSTFLASH_MAXCHIPS) {
+    return false;
+  }
+
+  _fd = ::open(path, O_RDWR | O_CREAT, 0644);
+  struct stat _st;
+  if (_fd < 0 || fstat(_fd, &_st)) {
+    close();
+    return false;
+  }
+  if (!capacity) {
+    capacity = _st.st_size ? _st.st_size : _profile->capacity;
+  }
+  if (_profile->capacityID ? capacity != _profile->capacity : (capacity < KB(64) || capacity > MB(32) || (capacity & (capacity - 1)))) {
+    close();
+    return false;
+  }
+  if ((uint64_t)_st.st_size < capacity && ftruncate(_fd, capacity)) {
+    close();
+    return false;
+  }
+  void *_map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (_map == MAP_FAILED) {
+    close();
+    return false;
+  }
+  _mem = (uint8_t *)_map;
+  _capacity = capacity;
+  if ((uint64_t)_st.st_size < capacity) {
+    memset(&_mem[_st.st_size], 0xFF, capacity - _st.st_size);
+  }
+  // Power on state. SST26 parts start up with every block write protected
+  _wel = _fourByte = _poweredDown = false;
+  _locked = (_profile->manufacturerID == MICROCHIP_MANID && _profile->memoryTypeID == MICROCHIP_SST26);
+  _busyUntil = 0;
+  _busyOp = _suspendedOp = 0;
+  _chips[_slot] = this;
+  resetStats();
+  return true;
+}
+
+// Writes any changes to the image back to the file. Returns false if the write fails.
+bool HostFlash::sync() {
+  return _mem && msync(_mem, _capacity, MS_SYNC) == 0;
+}
+
+// Writes any changes back to the file, unmaps it and detaches the chip from the SPI bus
+void HostFlash::close() {
+  if (_mem) {
+    msync(_mem, _capacity, MS_SYNC);
+    munmap(_mem, _capacity);
+  }
+  if (_fd >= 0) {
+    ::close(_fd);
+  }
+  for (uint8_t i = 0; i < HOSTFLASH_MAXCHIPS; i++) {
+    if (_chips[i] == this) {
+      _chips[i] = NULL;
+    }
+  }
+  if (_selected == this) {
+    _selected = NULL;
+  }
+  _fd = -1;
+  _mem = NULL;
+  _capacity = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                                Image                               //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the mapped image - for host tools that need to inspect it directly. NULL if no image is open
+uint8_t *HostFlash::data() {
+  return _mem;
+}
+
+// Returns the capacity of the chip in bytes
+uint32_t HostFlash::capacity() {
+  return _capacity;
+}
+
+// Returns the profile of the part being emulated
+const HostFlashProfile &HostFlash::profile() {
+  return *_profile;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                             Statistics                             //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the counters collected since open() or the last resetStats()
+const HostFlashStats &HostFlash::stats() {
+  return _stats;
+}
+
+// Clears the counters and starts timing from now
+void HostFlash::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+  _statsStart = hostNanos();
+}
+
+// Returns the virtual time that has passed since open() or the last resetStats() - in nanoseconds
+uint64_t HostFlash::elapsedNs() {
+  return hostNanos() - _statsStart;
+}
+
+// Returns the fraction of the elapsed time the bus spent clocking bytes to and from this chip
+float HostFlash::busUtilization() {
+  uint64_t _elapsed = elapsedNs();
+  return _elapsed ? (float)_stats.busNs / _elapsed : 0;
+}
+
+// Prints the elapsed time, bus utilisation and what the chip did since open() or the last resetStats()
+//  Takes one argument -
+//    1. out --> Where to print the report, e.g. Serial
+void HostFlash::report(Print &out) {
+  out.print(_profile->name);
+  out.print(F(" @ "));
+  out.print(_clock / 1000000.0, 1);
+  out.println(F(" MHz"));
+  out.print(F("  Elapsed:      "));
+  out.print(elapsedNs() / 1000000.0, 3);
+  out.println(F(" ms"));
+  out.print(F("  Bus:          "));
+  out.print(_stats.busNs / 1000000.0, 3);
+  out.print(F(" ms ("));
+  out.print(busUtilization() * 100, 1);
+  out.println(F("%)"));
+  out.print(F("  Chip busy:    "));
+  out.print(_stats.busyNs / 1000000.0, 3);
+  out.println(F(" ms"));
+  out.print(F("  Busy wait:    "));
+  out.print(_stats.waitNs / 1000000.0, 3);
+  out.print(F(" ms in "));
+  out.print((unsigned long)_stats.polls);
+  out.println(F(" polls"));
+  out.print(F("  Transactions: "));
+  out.println((unsigned long)_stats.transactions);
+  out.print(F("  Bytes:        "));
+  out.print((unsigned long)_stats.bytes);
+  out.print(F(" ("));
+  out.print((unsigned long)_stats.cmdBytes);
+  out.println(F(" command, address and dummy)"));
+  out.print(F("  Programs:     "));
+  out.println((unsigned long)_stats.programs);
+  out.print(F("  Erases:       "));
+  out.println((unsigned long)_stats.erases);
+  out.print(F("  Suspends:     "));
+  out.println((unsigned long)_stats.suspends);
+  if (_stats.overclocked) {
+    out.print(F("  Overclocked:  "));
+    out.print((unsigned long)_stats.overclocked);
+    out.println(F(" bytes read back corrupted"));
+  }
+}
+
+// Sets the time the MCU takes around each transaction (selecting and deselecting the chip) and between
+// bytes within one. Defaults to HOSTFLASH_TRANSACTIONNS and 0.
+//  Takes two arguments -
+//    1. transactionNs --> Time added for every transaction - in nanoseconds
+//    2. byteNs --> Time added for every byte on top of the 8 clock periods - in nanoseconds
+void HostFlash::setBusOverhead(uint32_t transactionNs, uint32_t byteNs) {
+  _transactionNs = transactionNs;
+  _byteNs = byteNs;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                               SPI bus                              //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Called by digitalWrite(). Selects the chip attached to the pin when it goes LOW and completes its command when it goes HIGH
+void HostFlash::pinWrite(uint8_t pin, uint8_t val) {
+  for (uint8_t i = 0; i < HOSTFLASH_MAXCHIPS; i++) {
+    if (_chips[i] && _chips[i]->_cs == pin) {
+      if (val == LOW && _selected != _chips[i]) {
+        if (_selected) {
+          _selected->_deselect();
+        }
+        _chips[i]->_select();
+      }
+      else if (val == HIGH && _selected == _chips[i]) {
+        _chips[i]->_deselect();
+      }
+    }
+  }
+}
+
+// Called by SPI.beginTransaction(). Sets the SCK frequency that bytes are clocked at
+void HostFlash::setClock(uint32_t clock) {
+  _clock = clock;
+}
+
+// Called by SPI.transfer(). Clocks a byte through the selected chip. Reads 0xFF if no chip is selected
+uint8_t HostFlash::transfer(uint8_t data) {
+  if (!_selected) {
+    hostAdvance(_clock ? 8000000000ULL / _clock : 0);
+    return 0xFF;
+  }
+  return _selected->_transfer(data);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+void HostFlash::_select() {
+  _selected = this;
+  _opcode = 0;
+  _count = 0;
+  _addr = 0;
+  _pageBytes = 0;
+  _overclocked = false;
+  _stats.transactions++;
+  // Time between the previous transaction and one that finds the chip busy is spent waiting for it
+  _selectNs = hostNanos();
+  _startedBusy = _busy();
+  if (_startedBusy) {
+    _stats.waitNs += _selectNs - _deselectNs;
+  }
+  hostAdvance(_transactionNs);
+}
+
+// Completes the command that was clocked in. Like the real chip, programs and erases only start when chip
+// select goes HIGH, and only if the write enable latch is set and the whole address has been received.
+void HostFlash::_deselect() {
+  _selected = NULL;
+  _deselectNs = hostNanos();
+  if (_startedBusy) {
+    _stats.waitNs += _deselectNs - _selectNs;
+    _stats.polls++;
+  }
+  if (!_count) {
+    return;
+  }
+  _stats.cmdBytes += (_count < _headerBytes()) ? _count : _headerBytes();
+  bool _haveAddr = _count > _addrBytes();
+
+  // Suspend and resume opcodes differ between manufacturers
+  if (_opcode == _profile->suspendOp) {
+    if (_busy() && _busyOp && !_suspendedOp) {
+      _remainNs = _busyUntil - hostNanos();
+      _suspendedOp = _busyOp;
+      _busyOp = 0;
+      _busyUntil = hostNanos() + (uint64_t)_profile->tSUS * 1000;
+      _stats.suspends++;
+    }
+    return;
+  }
+  if (_opcode == _profile->resumeOp) {
+    if (_suspendedOp && !_busy()) {
+      _busyUntil = hostNanos() + _remainNs;
+      _busyOp = _suspendedOp;
+      _suspendedOp = 0;
+    }
+    return;
+  }
+
+  switch (_opcode) {
+    case JEDEC_SET_WRITE_ENABLE:
+    _wel = true;
+    break;
+
+    case JEDEC_SET_WRITE_DISABLE:
+    _wel = false;
+    break;
+
+    case JEDEC_PROG_BYTE:
+    // A program can run while an erase is suspended, but not while another program is
+    if (_wel && _pageBytes && !_locked && _suspendedOp != JEDEC_PROG_BYTE) {
+      uint32_t _pageAddr = _mask(_addr) & ~(uint32_t)(SPI_PAGESIZE - 1);
+      for (uint16_t i = 0; i < SPI_PAGESIZE; i++) {
+        _mem[_pageAddr + i] &= _page[i];
+      }
+      uint16_t _n = (_pageBytes < SPI_PAGESIZE) ? _pageBytes : SPI_PAGESIZE;
+      _startBusy(_profile->tBP + (uint32_t)((uint64_t)(_profile->tPP - _profile->tBP) * (_n - 1) / (SPI_PAGESIZE - 1)));
+      _stats.programs++;
+    }
+    _wel = false;
+    break;
+
+    case JEDEC_ERASE_SECTOR:
+    case JEDEC_ERASE_BLOCK_32:
+    case JEDEC_ERASE_BLOCK_64:
+    if (_wel && _haveAddr && !_locked && !_suspendedOp) {
+      uint32_t _size = (_opcode == JEDEC_ERASE_SECTOR) ? KB(4) : (_opcode == JEDEC_ERASE_BLOCK_32) ? KB(32) : KB(64);
+      memset(&_mem[_mask(_addr) & ~(_size - 1)], 0xFF, _size);
+      _startBusy((_opcode == JEDEC_ERASE_SECTOR) ? _profile->tSE : (_opcode == JEDEC_ERASE_BLOCK_32) ? _profile->tBE32 : _profile->tBE64);
+      _stats.erases++;
+    }
+    _wel = false;
+    break;
+
+    case JEDEC_ERASE_CHIP:
+    case 0xC7:                            // Alternative chip erase opcode
+    if (_wel && !_locked && !_suspendedOp) {
+      memset(_mem, 0xFF, _capacity);
+      _startBusy(_profile->tCE);
+      _stats.erases++;
+    }
+    _wel = false;
+    break;
+
+    case ULBPR:
+    if (_wel) {
+      _locked = false;
+    }
+    _wel = false;
+    break;
+
+    case JEDEC_PROG_STATREG:
+    case WINBOND_PROG_STATREG_2:
+    case WINBOND_PROG_STATREG_3:
+    // Protection bits are not emulated
+    _wel = false;
+    break;
+
+    case JEDEC_SET_4_BYTE_ADDR_ENABLE:
+    _fourByte = true;
+    break;
+
+    case JEDEC_SET_4_BYTE_ADDR_DISABLE:
+    _fourByte = false;
+    break;
+
+    case JEDEC_SET_POWERDOWN:
+    _poweredDown = true;
+    break;
+
+    case JEDEC_SET_RELEASE:
+    _poweredDown = false;
+    break;
+  }
+}
+
+// Clocks one byte of the current command through the chip and returns the byte the chip drives back.
+// Bytes read back at a clock the part cannot follow arrive one bit late.
+uint8_t HostFlash::_transfer(uint8_t data) {
+  uint64_t _ns = _clock ? 8000000000ULL / _clock : 0;
+  hostAdvance(_ns + _byteNs);
+  _stats.busNs += _ns;
+  _stats.bytes++;
+
+  uint32_t _i = _count++;
+  if (!_i) {
+    _opcode = data;
+    if (_poweredDown && data != JEDEC_SET_RELEASE) {
+      _opcode = 0;                      // A powered down chip only responds to a release from power down
+    }
+    else if (_busy() && data != JEDEC_READ_STATREG && data != WINBOND_READ_STATREG_2 && data != WINBOND_READ_STATREG_3 && data != _profile->suspendOp) {
+      _opcode = 0;                      // A busy chip only responds to status reads and suspend
+    }
+    uint32_t _limit = (_opcode == JEDEC_READ_DATA) ? _profile->maxReadClock : _profile->maxClock;
+    _overclocked = _limit && _clock > _limit;
+    _lastOut = 0xFF;
+    return 0xFF;
+  }
+
+  uint8_t _out = _respond(data, _i);
+  if (_overclocked) {
+    uint8_t _late = (_out >> 1) | (_lastOut << 7);
+    _lastOut = _out;
+    _stats.overclocked++;
+    return _late;
+  }
+  return _out;
+}
+
+// Returns the byte the chip drives back for byte index of the current command - the opcode being byte 0
+uint8_t HostFlash::_respond(uint8_t data, uint32_t index) {
+  uint8_t _alen = _addrBytes();
+
+  switch (_opcode) {
+    case JEDEC_READ_STATREG:
+    case WINBOND_READ_STATREG_2:
+    case WINBOND_READ_STATREG_3:
+    return _status(_opcode);
+
+    case JEDEC_READ_JEDECID:
+    switch (index) {
+      case 1: return _profile->manufacturerID;
+      case 2: return _profile->memoryTypeID;
+      case 3: {
+        if (_profile->capacityID) {
+          return _profile->capacityID;
+        }
+        uint8_t _log2 = 0;
+        while ((1UL << _log2) < _capacity) {
+          _log2++;
+        }
+        return 0x10 + _log2 - 16;       // Capacity IDs 0x10 (64 KB) to 0x19 (32 MB)
+      }
+    }
+    return 0xFF;
+
+    case JEDEC_READ_MANSIG:
+    // Three address bytes, then the manufacturer and device IDs
+    return (index < 4) ? 0xFF : ((index & 1) ? _profile->manufacturerID : HOSTFLASH_DEVICEID);
+
+    case JEDEC_SET_RELEASE:
+    return (index < 4) ? 0xFF : HOSTFLASH_DEVICEID;
+
+    case JEDEC_READ_UNIQUE_ID:
+    // Four dummy bytes, then a 64 bit ID
+    return (index < 5) ? 0xFF : (uint8_t)(0x48 + _cs + index);
+
+    case JEDEC_READ_SFDP:
+    if (index <= 3) {
+      _addr = (_addr << 8) | data;
+      return 0xFF;
+    }
+    if (index == 4) {
+      return 0xFF;
+    }
+    {
+      return _sfdp(_addr + index - 5);
+    }
+
+    case JEDEC_READ_DATA:
+    case JEDEC_READ_FAST:
+    if (index <= _alen) {
+      _addr = (_addr << 8) | data;
+      return 0xFF;
+    }
+    if (_opcode == JEDEC_READ_FAST && index == _alen + 1U) {
+      return 0xFF;                        // Dummy byte
+    }
+    // Reads continue through the whole array and wrap around at the end
+    return _mem[_mask(_addr + index - _alen - ((_opcode == JEDEC_READ_FAST) ? 2 : 1))];
+
+    case JEDEC_PROG_BYTE:
+    if (index <= _alen) {
+      _addr = (_addr << 8) | data;
+      if (index == _alen) {
+        memset(_page, 0xFF, SPI_PAGESIZE);
+      }
+      return 0xFF;
+    }
+    // Data wraps around to the start of the page. If more than a page is sent the last bytes replace the first
+    _page[(_addr + index - _alen - 1) % SPI_PAGESIZE] = data;
+    _pageBytes++;
+    return 0xFF;
+
+    case JEDEC_ERASE_SECTOR:
+    case JEDEC_ERASE_BLOCK_32:
+    case JEDEC_ERASE_BLOCK_64:
+    if (index <= _alen) {
+      _addr = (_addr << 8) | data;
+    }
+    return 0xFF;
+  }
+  return 0xFF;
+}
+
+// Returns status register 1, 2 or 3. SST26 parts report a suspend in status register 1, the others in register 2
+uint8_t HostFlash::_status(uint8_t opcode) {
+  bool _sst = (_profile->manufacturerID == MICROCHIP_MANID);
+  uint8_t _stat = 0;
+  switch (opcode) {
+    case JEDEC_READ_STATREG:
+    _stat = (_busy() ? BUSY : 0) | (_wel ? WRTEN : 0);
+    if (_sst && _suspendedOp) {
+      _stat |= (_suspendedOp == JEDEC_PROG_BYTE) ? WSP : WSE;
+    }
+    break;
+
+    case WINBOND_READ_STATREG_2:
+    _stat = (!_sst && _suspendedOp) ? SUS : 0;
+    break;
+
+    case WINBOND_READ_STATREG_3:
+    _stat = _fourByte ? ADS : 0;
+    break;
+  }
+  return _stat;
+}
+
+// Encodes a time in microseconds as an SFDP count (5 bits) and unit, picking the finest unit the time fits in.
+// The time is rounded up, as the tables give (count + 1) * unit.
+static uint8_t _sfdpTime(uint32_t us, const uint32_t *units, uint8_t numUnits) {
+  uint8_t _unit = 0;
+  while (_unit < numUnits - 1 && (us + units[_unit] - 1) / units[_unit] > 32) {
+    _unit++;
+  }
+  uint32_t _count = (us + units[_unit] - 1) / units[_unit];
+  _count = (_count < 1) ? 1 : ((_count > 32) ? 32 : _count);
+  return (_unit << 5) | (_count - 1);
+}
+
+// Returns the byte at addr in the SFDP table. Timed profiles carry a JESD216B Basic Flash Parameter Table at 0x10
+// with their typical program and erase times, and the max times set to 10x (erases) / 8x (page program) of those.
+// The instant profile has only the "SFDP" signature, like parts that predate the parameter tables.
+uint8_t HostFlash::_sfdp(uint32_t addr) {
+  const uint32_t _eraseUnits[4] = {1000, 16000, 128000, 1000000};
+  const uint32_t _progUnits[2] = {8, 64};
+  const uint32_t _chipUnits[4] = {16000, 256000, 4000000, 64000000};
+  uint32_t _table[20];
+
+  memset(_table, 0xFF, sizeof(_table));
+  _table[0] = VOYNICH_SFDP_SIGNATURE;
+  if (_profile->tSE) {
+    _table[1] = 0xFF000106;               // Revision 1.6, one parameter header
+    _table[2] = 0x10010600;               // BFPT revision 1.6, 16 DWORDs long ...
+    _table[3] = 0xFF000010;               // ... at 0x10
+    _table[4 + 1] = _capacity * 8 - 1;    // Density in bits
+    _table[4 + 7] = 0x520F200C;           // Erase types 1 and 2 - 4 KB (0x20) and 32 KB (0x52)
+    _table[4 + 8] = 0x0000D810;           // Erase type 3 - 64 KB (0xD8). No type 4
+    _table[4 + 9] = 0x00000004            // Erase times, max = 2 * (4 + 1) * typical
+                  | (uint32_t)_sfdpTime(_profile->tSE, _eraseUnits, 4) << 4
+                  | (uint32_t)_sfdpTime(_profile->tBE32, _eraseUnits, 4) << 11
+                  | (uint32_t)_sfdpTime(_profile->tBE64, _eraseUnits, 4) << 18;
+    _table[4 + 10] = 0x00000083           // 256 byte pages, max = 2 * (3 + 1) * typical
+                   | (uint32_t)_sfdpTime(_profile->tPP, _progUnits, 2) << 8
+                   | (uint32_t)_sfdpTime(_profile->tCE, _chipUnits, 4) << 24;
+  }
+  return (addr < sizeof(_table)) ? (uint8_t)(_table[addr / 4] >> (8 * (addr % 4))) : 0xFF;
+}
+
+bool HostFlash::_busy() {
+  return hostNanos() < _busyUntil;
+}
+
+// Keeps the chip busy with the command just started for the given time
+void HostFlash::_startBusy(uint32_t us) {
+  _busyOp = _opcode;
+  _busyUntil = hostNanos() + (uint64_t)us * 1000;
+  _stats.busyNs += (uint64_t)us * 1000;
+}
+
+// Number of address bytes sent with commands that take an address
+uint8_t HostFlash::_addrBytes() {
+  return _fourByte ? 4 : 3;
+}
+
+// Number of opcode, address and dummy bytes at the start of the current command
+uint8_t HostFlash::_headerBytes() {
+  switch (_opcode) {
+    case JEDEC_READ_DATA:
+    case JEDEC_PROG_BYTE:
+    case JEDEC_ERASE_SECTOR:
+    case JEDEC_ERASE_BLOCK_32:
+    case JEDEC_ERASE_BLOCK_64:
+    return 1 + _addrBytes();
+
+    case JEDEC_READ_FAST:
+    return 2 + _addrBytes();
+
+    case JEDEC_READ_SFDP:
+    case JEDEC_READ_UNIQUE_ID:
+    return 5;
+
+    case JEDEC_READ_MANSIG:
+    case JEDEC_SET_RELEASE:
+    return 4;
+  }
+  return 1;
+}
+
+// Wraps an address to the capacity of the chip - the upper address bits are ignored by the chip
+uint32_t HostFlash::_mask(uint32_t addr) {
+  return addr & (_capacity - 1);
+}
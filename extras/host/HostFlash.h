@@ -0,0 +1,150 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOSTFLASH_H
+#define HOSTFLASH_H
+
+#include "Arduino.h"
+#include "defines.h"
+
+#define HOSTFLASH_MAXCHIPS  4       // Number of chips that can be attached to the host SPI bus at once
+
+// Describes the part a HostFlash emulates - its IDs, the SPI clock it can follow and how long it stays busy.
+// Times are typical datasheet values in microseconds. A page program of n bytes takes
+// tBP + (tPP - tBP) * (n - 1) / 255.
+struct HostFlashProfile {
+  const char *name;
+  uint8_t  manufacturerID, memoryTypeID;
+  uint8_t  capacityID;        // 0 --> Derived from the capacity, as Winbond and Cypress number their parts
+  uint32_t capacity;          // Capacity of a new image if none is passed to open()
+  uint32_t maxClock;          // Highest SCK in Hz. Bytes read back faster than this are corrupted. 0 --> No limit
+  uint32_t maxReadClock;      // Highest SCK in Hz for JEDEC_READ_DATA, which has no dummy byte
+  uint32_t tBP, tPP;          // First byte / whole page program
+  uint32_t tSE, tBE32, tBE64; // Sector, 32 KB block and 64 KB block erase
+  uint32_t tCE;               // Chip erase
+  uint32_t tSUS;              // Suspend latency
+  uint8_t  suspendOp, resumeOp;
+};
+
+extern const HostFlashProfile hostFlashInstant;   // W25Q compatible, never busy and no clock limit. The default
+extern const HostFlashProfile hostFlashW25Q64;    // Winbond W25Q64JV
+extern const HostFlashProfile hostFlashSST26;     // Microchip SST26VF064B
+extern const HostFlashProfile hostFlashS25FL;     // Cypress S25FL116K
+
+// Counters kept for each chip since open() or resetStats()
+struct HostFlashStats {
+  uint64_t transactions;      // Number of times the chip was selected
+  uint64_t bytes;             // Bytes clocked to and from the chip
+  uint64_t cmdBytes;          // Of those, opcode, address and dummy bytes
+  uint64_t busNs;             // Time the bus spent clocking bytes
+  uint64_t busyNs;            // Time the chip spent programming and erasing
+  uint64_t polls;             // Transactions started while the chip was busy - status polls, mostly
+  uint64_t waitNs;            // Time the host spent on those transactions and the gaps before them
+  uint32_t programs, erases, suspends;
+  uint32_t overclocked;       // Bytes read back at a clock above the profile's limit
+};
+
+// Emulates a SPI NOR flash chip on a Linux host, backed by a memory-mapped image file.
+// The chip answers the same SPI commands as the real part, so SPIFlash - and everything built on
+// it - runs unchanged on the host. Programming ANDs the new data into the image (bits can only go
+// from 1 to 0) and wraps within the 256 byte page; erasing a sector, block or the whole chip fills
+// it with 0xFF. Commands take effect when chip select goes HIGH.
+//
+// The host runs on a virtual clock (see hostNanos() in Arduino.h). Every byte on the bus moves it on
+// by 8 SCK periods at the clock passed to SPI.beginTransaction(), every transaction by the bus overhead,
+// and programs and erases keep the chip busy for the times in its profile. micros() therefore reports
+// what the same code would take on hardware, while running at memory speed. With the default
+// hostFlashInstant profile the chip is never busy, so host tools build and verify images at memory speed.
+//
+//    HostFlash image(CS, hostFlashW25Q64);
+//    image.open("data.bin");             // Creates an erased 8 MB image if the file does not exist
+//    SPIFlash flash(CS);
+//    flash.begin();                      // Identified as a W25Q64 with a capacity of 8 MB
+//    ...
+//    image.report(Serial);               // Virtual elapsed time, bus utilisation and chip activity
+class HostFlash {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  HostFlash(uint8_t cs = SS, const HostFlashProfile &profile = hostFlashInstant);
+  ~HostFlash();
+  //------------------------------------ Image file -------------------------------------//
+  bool     open(const char *path, uint32_t capacity = 0);
+  bool     sync();
+  void     close();
+  //--------------------------------------- Image ---------------------------------------//
+  uint8_t *data();
+  uint32_t capacity();
+  const HostFlashProfile &profile();
+  //------------------------------------- Statistics ------------------------------------//
+  const HostFlashStats &stats();
+  void     resetStats();
+  uint64_t elapsedNs();
+  float    busUtilization();
+  void     report(Print &out);
+  static void setBusOverhead(uint32_t transactionNs, uint32_t byteNs);
+  //--------------------------------- SPI bus (internal) --------------------------------//
+  static void    pinWrite(uint8_t pin, uint8_t val);
+  static void    setClock(uint32_t clock);
+  static uint8_t transfer(uint8_t data);
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  void     _select();
+  void     _deselect();
+  uint8_t  _transfer(uint8_t data);
+  uint8_t  _respond(uint8_t data, uint32_t index);
+  uint8_t  _status(uint8_t opcode);
+  uint8_t  _sfdp(uint32_t addr);
+  bool     _busy();
+  void     _startBusy(uint32_t us);
+  uint8_t  _addrBytes();
+  uint8_t  _headerBytes();
+  uint32_t _mask(uint32_t addr);
+  //-------------------------------- Private variables ----------------------------------//
+  static HostFlash *_chips[HOSTFLASH_MAXCHIPS];
+  static HostFlash *_selected;
+  static uint32_t _clock, _transactionNs, _byteNs;
+  const HostFlashProfile *_profile;
+  uint8_t     _cs;
+  int         _fd;
+  uint8_t     *_mem;
+  uint32_t    _capacity;
+  // State of the command in progress
+  uint8_t     _opcode, _lastOut;
+  uint32_t    _count, _addr;
+  bool        _overclocked, _startedBusy;
+  uint64_t    _selectNs, _deselectNs;
+  // Status
+  bool        _wel, _fourByte, _poweredDown, _locked;
+  uint64_t    _busyUntil, _remainNs;
+  uint8_t     _busyOp, _suspendedOp;
+  // Data clocked in by a page program. Bytes that were not sent stay at 0xFF and so leave the flash unchanged
+  uint8_t     _page[SPI_PAGESIZE];
+  uint16_t    _pageBytes;
+  // Statistics
+  HostFlashStats _stats;
+  uint64_t    _statsStart;
+};
+
+#endif // HOSTFLASH_H
@@ -0,0 +1,61 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// SPI bus for building the library on a Linux host. Every transfer goes to the HostFlash chip whose
+// chip select pin was last driven LOW - see HostFlash.h.
+
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include "Arduino.h"
+
+#define SPI_HAS_TRANSACTION
+#define LSBFIRST  0
+#define MSBFIRST  1
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+  SPISettings() : clock(4000000) {}
+  SPISettings(uint32_t clockSpeed, uint8_t bitOrder, uint8_t dataMode) : clock(clockSpeed) {}
+  uint32_t clock;
+};
+
+class SPIClass {
+public:
+  void     begin() {}
+  void     end() {}
+  void     beginTransaction(SPISettings settings);
+  void     endTransaction() {}
+  uint8_t  transfer(uint8_t data);
+  uint16_t transfer16(uint16_t data);
+  void     transfer(void *buf, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif // HOST_SPI_H
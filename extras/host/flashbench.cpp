@@ -0,0 +1,304 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Measures the throughput and bus overhead of each part of the SPIFlash API against the simulated chips,
+// so that changes to the library can be compared across releases. Built by 'make benchmark'.
+//
+//    flashbench [-p profile]... [-k clock] [-j]
+//
+//    -p --> instant, w25q64, sst26 or s25fl. May be repeated. Defaults to all but instant
+//    -k --> SPI clock in Hz. Defaults to SPI_CLK
+//    -j --> Print JSON instead of CSV
+//
+// Each row is one call of the API repeated 'ops' times. For each it reports the payload throughput, the
+// transactions and bus bytes per call, how many of those bytes were opcode, address and dummy bytes, and how
+// long the host spent polling a busy chip. Times are virtual - see HostFlash.h.
+
+#include <SPIFlash.h>
+#include "HostFlash.h"
+#include <unistd.h>
+
+#define BENCH_REGION  KB(256)     // Writes go to the first BENCH_REGION bytes, which are erased before each write test
+
+struct BenchRecord {
+  uint32_t stamp;
+  uint16_t id;
+  uint8_t  flags;
+  uint8_t  payload[25];
+};
+
+static bool json = false;
+static bool firstRow = true;
+static const HostFlashProfile *profile;
+static uint32_t clockHz = SPI_CLK;
+static HostFlash *chip;
+static SPIFlash *flash;
+
+static const HostFlashProfile *findProfile(const char *name) {
+  static const HostFlashProfile *const _profiles[] = { &hostFlashInstant, &hostFlashW25Q64, &hostFlashSST26, &hostFlashS25FL };
+  static const char *const _names[] = { "instant", "w25q64", "sst26", "s25fl" };
+  for (uint8_t i = 0; i < arrayLen(_names); i++) {
+    if (!strcmp(name, _names[i])) {
+      return _profiles[i];
+    }
+  }
+  return NULL;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                               Output                               //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static void printHeader() {
+  if (json) {
+    printf("{\n  \"library\": \"3.1.0\",\n  \"results\": [\n");
+  }
+  else {
+    printf("profile,clock_hz,test,size,align,ops,errors,bytes,elapsed_us,bytes_per_s,us_per_op,"
+           "transactions_per_op,bus_bytes_per_op,cmd_bytes_per_op,wait_us_per_op,polls_per_op,bus_utilization\n");
+  }
+}
+
+static void printFooter() {
+  if (json) {
+    printf("\n  ]\n}\n");
+  }
+}
+
+static void printRow(const char *test, uint32_t size, uint32_t align, uint32_t ops, uint32_t errors) {
+  const HostFlashStats &_s = chip->stats();
+  double _elapsedUs = chip->elapsedNs() / 1000.0;
+  uint64_t _bytes = (uint64_t)size * ops;
+  double _bps = _elapsedUs > 0 ? _bytes * 1000000.0 / _elapsedUs : 0;
+  if (json) {
+    printf("%s    {\"profile\": \"%s\", \"clock_hz\": %u, \"test\": \"%s\", \"size\": %u, \"align\": %u, \"ops\": %u, "
+           "\"errors\": %u, \"bytes\": %llu, \"elapsed_us\": %.3f, \"bytes_per_s\": %.1f, \"us_per_op\": %.3f, "
+           "\"transactions_per_op\": %.2f, \"bus_bytes_per_op\": %.2f, \"cmd_bytes_per_op\": %.2f, "
+           "\"wait_us_per_op\": %.3f, \"polls_per_op\": %.2f, \"bus_utilization\": %.4f}",
+           firstRow ? "" : ",\n", profile->name, (unsigned)clockHz, test, (unsigned)size, (unsigned)align, (unsigned)ops,
+           (unsigned)errors, (unsigned long long)_bytes, _elapsedUs, _bps, _elapsedUs / ops,
+           (double)_s.transactions / ops, (double)_s.bytes / ops, (double)_s.cmdBytes / ops,
+           _s.waitNs / 1000.0 / ops, (double)_s.polls / ops, chip->busUtilization());
+  }
+  else {
+    printf("%s,%u,%s,%u,%u,%u,%u,%llu,%.3f,%.1f,%.3f,%.2f,%.2f,%.2f,%.3f,%.2f,%.4f\n",
+           profile->name, (unsigned)clockHz, test, (unsigned)size, (unsigned)align, (unsigned)ops, (unsigned)errors,
+           (unsigned long long)_bytes, _elapsedUs, _bps, _elapsedUs / ops, (double)_s.transactions / ops,
+           (double)_s.bytes / ops, (double)_s.cmdBytes / ops, _s.waitNs / 1000.0 / ops, (double)_s.polls / ops,
+           chip->busUtilization());
+  }
+  firstRow = false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                                Tests                               //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Waits for the chip to finish anything still running, so it is not charged to the next test
+static void settle() {
+  while (flash->isBusy()) {
+    delayMicroseconds(10);
+  }
+}
+
+// Runs op(i) for i = 0 .. ops - 1 and prints a row. op returns false on an error
+template <class Op> static void run(const char *test, uint32_t size, uint32_t align, uint32_t ops, Op op) {
+  settle();
+  chip->resetStats();
+  uint32_t _errors = 0;
+  for (uint32_t i = 0; i < ops; i++) {
+    _errors += !op(i);
+  }
+  settle();
+  printRow(test, size, align, ops, _errors);
+}
+
+// Erases the write region one block at a time, waiting for each erase to finish
+static void eraseRegion() {
+  for (uint32_t _addr = 0; _addr < BENCH_REGION; _addr += KB(64)) {
+    settle();
+    flash->eraseBlock64K(_addr);
+  }
+  settle();
+}
+
+static void readTests() {
+  static uint8_t _buf[KB(4)];
+  BenchRecord _rec;
+  run("readByte", 1, 0, 256, [&](uint32_t i) { flash->readByte(i); return true; });
+  run("readWord", 2, 0, 256, [&](uint32_t i) { flash->readWord(i * 2); return true; });
+  run("readAnything", sizeof(_rec), 0, 256, [&](uint32_t i) { return flash->readAnything(i * sizeof(_rec), _rec); });
+  const uint32_t _sizes[] = { 16, 256, KB(4) };
+  for (uint8_t f = 0; f < 2; f++) {
+    for (uint8_t s = 0; s < arrayLen(_sizes); s++) {
+      uint32_t _sz = _sizes[s];
+      run(f ? "readByteArray_fast" : "readByteArray", _sz, 0, KB(64) / _sz, [&](uint32_t i) {
+        return flash->readByteArray(i * _sz, _buf, _sz, f);
+      });
+    }
+  }
+}
+
+static void writeTests() {
+  static uint8_t _buf[KB(4)];
+  for (uint32_t i = 0; i < sizeof(_buf); i++) {
+    _buf[i] = i * 7;
+  }
+  BenchRecord _rec;
+  memset(&_rec, 0x5A, sizeof(_rec));
+
+  eraseRegion();
+  run("writeByte", 1, 0, 256, [&](uint32_t i) { return flash->writeByte(i, i); });
+  eraseRegion();
+  run("writeWord", 2, 0, 256, [&](uint32_t i) { return flash->writeWord(i * 2, i); });
+  eraseRegion();
+  run("writeLong", 4, 0, 256, [&](uint32_t i) { return flash->writeLong(i * 4, i); });
+  eraseRegion();
+  run("writeFloat", 4, 0, 256, [&](uint32_t i) { return flash->writeFloat(i * 4, i * 0.5f); });
+  eraseRegion();
+  run("writeAnything", sizeof(_rec), 0, 256, [&](uint32_t i) { _rec.stamp = i; return flash->writeAnything(i * sizeof(_rec), _rec); });
+
+  // Page aligned, then starting half way through a page so that every write spans a page boundary
+  const uint32_t _sizes[] = { 16, 64, 256, KB(1), KB(4) };
+  const uint32_t _aligns[] = { 0, SPI_PAGESIZE / 2 };
+  for (uint8_t a = 0; a < arrayLen(_aligns); a++) {
+    for (uint8_t s = 0; s < arrayLen(_sizes); s++) {
+      uint32_t _sz = _sizes[s], _align = _aligns[a];
+      uint32_t _stride = (_sz < SPI_PAGESIZE) ? SPI_PAGESIZE : _sz + SPI_PAGESIZE;
+      uint32_t _ops = (BENCH_REGION - SPI_PAGESIZE) / _stride;
+      if (_ops > 64) {
+        _ops = 64;
+      }
+      eraseRegion();
+      run("writeByteArray", _sz, _align, _ops, [&](uint32_t i) { return flash->writeByteArray(i * _stride + _align, _buf, _sz); });
+    }
+  }
+
+  eraseRegion();
+  run("writeByteArray_nocheck", SPI_PAGESIZE, 0, 64, [&](uint32_t i) { return flash->writeByteArray(i * SPI_PAGESIZE, _buf, SPI_PAGESIZE, false); });
+
+  // Three segments over seven pages - each page is prepared while the program of the one before it is still running
+  eraseRegion();
+  run("writev", 1500, 10, 64, [&](uint32_t i) {
+    uint32_t _base = i * KB(2) + 10;
+    FlashIOVec _v[3] = { { _base, _buf, 700 }, { _base + 710, _buf + 700, 500 }, { _base + 1290, _buf + 1200, 300 } };
+    return flash->writev(_v, 3);
+  });
+}
+
+static void eraseTests() {
+  run("eraseSector", KB(4), 0, 8, [&](uint32_t i) { return flash->eraseSector(i * KB(4)); });
+  run("eraseBlock32K", KB(32), 0, 4, [&](uint32_t i) { return flash->eraseBlock32K(i * KB(32)); });
+  run("eraseBlock64K", KB(64), 0, 2, [&](uint32_t i) { return flash->eraseBlock64K(i * KB(64)); });
+  // 64 KB + 32 KB + 4 KB, so that eraseSection has to use all three erase sizes
+  run("eraseSection", KB(100), 0, 2, [&](uint32_t i) { return flash->eraseSection(i * KB(128), KB(100)); });
+}
+
+static void getAddressTests() {
+  static uint8_t _buf[KB(4)];
+  memset(_buf, 0, sizeof(_buf));
+  eraseRegion();
+  {
+    SPIFlash _fresh(CS);
+    _fresh.begin();
+    run("getAddress", 16, 0, 256, [&](uint32_t i) { return _fresh.getAddress(16) == i * 16; });
+  }
+  // The first 4 KB are in use, so the first call has to step over 256 used slots
+  flash->writeByteArray(0, _buf, sizeof(_buf));
+  {
+    SPIFlash _fresh(CS);
+    _fresh.begin();
+    run("getAddress_scan", 16, 0, 1, [&](uint32_t i) { return _fresh.getAddress(16) == KB(4); });
+  }
+}
+
+static bool benchmark(const HostFlashProfile &p) {
+  char _path[] = "/tmp/flashbenchXXXXXX";
+  int _fd = mkstemp(_path);
+  if (_fd < 0) {
+    return false;
+  }
+  ::close(_fd);
+  unlink(_path);
+
+  HostFlash _chip(CS, p);
+  SPIFlash _flash(CS);
+  bool _ok = _chip.open(_path, 0) && _flash.begin();
+  if (_ok) {
+    profile = &p;
+    chip = &_chip;
+    flash = &_flash;
+    _flash.setClock(clockHz);
+    readTests();
+    writeTests();
+    eraseTests();
+    getAddressTests();
+  }
+  _chip.close();
+  unlink(_path);
+  return _ok;
+}
+
+int main(int argc, char **argv) {
+  const HostFlashProfile *_profiles[HOSTFLASH_MAXCHIPS * 2];
+  uint8_t _count = 0;
+  int _opt;
+  while ((_opt = getopt(argc, argv, "p:k:j")) != -1) {
+    switch (_opt) {
+      case 'p':
+      if (_count == arrayLen(_profiles) || !(_profiles[_count++] = findProfile(optarg))) {
+        fprintf(stderr, "flashbench: unknown profile '%s'\n", optarg);
+        return 2;
+      }
+      break;
+
+      case 'k':
+      clockHz = strtoul(optarg, NULL, 0);
+      break;
+
+      case 'j':
+      json = true;
+      break;
+
+      default:
+      fprintf(stderr, "usage: flashbench [-p instant|w25q64|sst26|s25fl]... [-k clock] [-j]\n");
+      return 2;
+    }
+  }
+  if (!_count) {
+    _profiles[_count++] = &hostFlashW25Q64;
+    _profiles[_count++] = &hostFlashSST26;
+    _profiles[_count++] = &hostFlashS25FL;
+  }
+
+  printHeader();
+  for (uint8_t i = 0; i < _count; i++) {
+    if (!benchmark(*_profiles[i])) {
+      fprintf(stderr, "flashbench: cannot start %s\n", _profiles[i]->name);
+      return 1;
+    }
+  }
+  printFooter();
+  return 0;
+}
@@ -0,0 +1,206 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Builds, inspects and verifies flash images on the host through the SPIFlash API. An image written
+// here can be programmed into a chip with any external programmer and the firmware will find the
+// data exactly as if it had written it itself.
+//
+//    flashimage create <image> <size>
+//    flashimage info   <image>
+//    flashimage erase  <image> <addr> <length>
+//    flashimage write  <image> <addr> <file>
+//    flashimage read   <image> <addr> <length> [file]
+//    flashimage verify <image> <addr> <file>
+//
+// Sizes, addresses and lengths are decimal, 0x prefixed hex or carry a K or M suffix. Writes only
+// succeed on erased flash - erase the region first, as the firmware would.
+
+#include <SPIFlash.h>
+#include "HostFlash.h"
+
+#define CHUNK   KB(4)
+
+HostFlash image(CS);
+SPIFlash flash(CS);
+
+static uint32_t parseSize(const char *str) {
+  char *_end;
+  uint32_t _val = strtoul(str, &_end, 0);
+  if (*_end == 'K' || *_end == 'k') {
+    _val *= KiB;
+  }
+  else if (*_end == 'M' || *_end == 'm') {
+    _val *= MiB;
+  }
+  return _val;
+}
+
+static int usage() {
+  fprintf(stderr, "usage: flashimage create <image> <size>\n"
+                  "       flashimage info   <image>\n"
+                  "       flashimage erase  <image> <addr> <length>\n"
+                  "       flashimage write  <image> <addr> <file>\n"
+                  "       flashimage read   <image> <addr> <length> [file]\n"
+                  "       flashimage verify <image> <addr> <file>\n");
+  return 2;
+}
+
+static int fail(const char *msg) {
+  fprintf(stderr, "flashimage: %s\n", msg);
+  return 1;
+}
+
+// Prints a line of hex and ASCII for every 16 bytes
+static void hexDump(uint32_t addr, const uint8_t *buf, uint32_t size) {
+  for (uint32_t i = 0; i < size; i += 16) {
+    printf("%08X ", (unsigned)(addr + i));
+    for (uint32_t j = i; j < i + 16; j++) {
+      j < size ? printf(" %02X", buf[j]) : printf("   ");
+    }
+    printf("  |");
+    for (uint32_t j = i; j < i + 16 && j < size; j++) {
+      putchar(buf[j] >= 0x20 && buf[j] < 0x7F ? buf[j] : '.');
+    }
+    printf("|\n");
+  }
+}
+
+static int info() {
+  uint32_t _blank = 0;
+  uint8_t _buf[CHUNK];
+  for (uint32_t _addr = 0; _addr < flash.getCapacity(); _addr += CHUNK) {
+    if (!flash.readByteArray(_addr, _buf, CHUNK)) {
+      return fail("read failed");
+    }
+    uint32_t i = 0;
+    while (i < CHUNK && _buf[i] == 0xFF) {
+      i++;
+    }
+    _blank += (i == CHUNK);
+  }
+  printf("JEDEC ID:       0x%06X\n", (unsigned)flash.getJEDECID());
+  printf("Capacity:       %u bytes\n", (unsigned)flash.getCapacity());
+  printf("Erased sectors: %u of %u\n", (unsigned)_blank, (unsigned)(flash.getCapacity() / KB(4)));
+  return 0;
+}
+
+// Writes a file to the image, or compares it with the image if verify is true
+static int writeFile(uint32_t addr, const char *path, bool verify) {
+  FILE *_file = fopen(path, "rb");
+  if (!_file) {
+    return fail("cannot open input file");
+  }
+  uint8_t _buf[CHUNK], _check[CHUNK];
+  size_t _n;
+  int _ret = 0;
+  while (!_ret && (_n = fread(_buf, 1, CHUNK, _file)) > 0) {
+    if (verify) {
+      if (!flash.readByteArray(addr, _check, _n)) {
+        _ret = fail("read failed");
+      }
+      for (size_t i = 0; !_ret && i < _n; i++) {
+        if (_buf[i] != _check[i]) {
+          fprintf(stderr, "flashimage: mismatch at 0x%08X\n", (unsigned)(addr + i));
+          _ret = 1;
+        }
+      }
+    }
+    else if (!flash.writeByteArray(addr, _buf, _n)) {
+      _ret = fail("write failed - is the region erased?");
+    }
+    addr += _n;
+  }
+  fclose(_file);
+  return _ret;
+}
+
+static int readOut(uint32_t addr, uint32_t size, const char *path) {
+  FILE *_file = path ? fopen(path, "wb") : NULL;
+  if (path && !_file) {
+    return fail("cannot open output file");
+  }
+  uint8_t _buf[CHUNK];
+  while (size) {
+    uint32_t _n = size < CHUNK ? size : CHUNK;
+    if (!flash.readByteArray(addr, _buf, _n)) {
+      return fail("read failed");
+    }
+    if (_file) {
+      fwrite(_buf, 1, _n, _file);
+    }
+    else {
+      hexDump(addr, _buf, _n);
+    }
+    addr += _n;
+    size -= _n;
+  }
+  if (_file) {
+    fclose(_file);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    return usage();
+  }
+  const char *_cmd = argv[1];
+  bool _create = !strcmp(_cmd, "create");
+  if (_create && argc != 4) {
+    return usage();
+  }
+  if (!image.open(argv[2], _create ? parseSize(argv[3]) : 0)) {
+    return fail("cannot map image - sizes must be a power of two from 64K to 32M");
+  }
+  if (!flash.begin()) {
+    return fail("flash not identified");
+  }
+
+  int _ret;
+  if (_create) {
+    _ret = 0;
+  }
+  else if (!strcmp(_cmd, "info") && argc == 3) {
+    _ret = info();
+  }
+  else if (!strcmp(_cmd, "erase") && argc == 5) {
+    _ret = flash.eraseSection(parseSize(argv[3]), parseSize(argv[4])) ? 0 : fail("erase failed");
+  }
+  else if (!strcmp(_cmd, "write") && argc == 5) {
+    _ret = writeFile(parseSize(argv[3]), argv[4], false);
+  }
+  else if (!strcmp(_cmd, "verify") && argc == 5) {
+    _ret = writeFile(parseSize(argv[3]), argv[4], true);
+  }
+  else if (!strcmp(_cmd, "read") && (argc == 5 || argc == 6)) {
+    _ret = readOut(parseSize(argv[3]), parseSize(argv[4]), argc == 6 ? argv[5] : NULL);
+  }
+  else {
+    _ret = usage();
+  }
+  if (!image.sync()) {
+    return fail("cannot write image");
+  }
+  return _ret;
+}
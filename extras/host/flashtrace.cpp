@@ -0,0 +1,625 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Decodes a command trace printed by SPIFlash::dumpTrace() (build the sketch with ENABLETRACE defined in
+// SPIFlash.h), shows where the time went and replays the trace against the HostFlash timing model to
+// predict what other settings would save. Built by 'make'.
+//
+//    flashtrace [-p profile] [-c clock] [-k clock] [file]
+//
+//    -p --> instant, w25q64, sst26 or s25fl. Defaults to the part matching the JEDEC ID in the dump, else w25q64
+//    -c --> SPI clock in Hz the trace was recorded at. Defaults to SPI_CLK
+//    -k --> Another SPI clock in Hz to predict the time for
+//
+// The dump is read from file, or from stdin if no file is given - a capture of the serial monitor works as
+// it is, since everything outside the dump is skipped. If the capture holds several dumps the last one is used.
+//
+// Time is attributed to each opcode and to the type of public function that issued it. A transaction's time
+// is the time the chip was selected plus the gap up to the next transaction. Status register polls are
+// grouped into waits: a wait is redundant if it started when nothing that makes the chip busy had been sent
+// since the chip last reported ready. 4-byte address mode toggles (0xB7 / 0xE9) are counted separately.
+//
+// The replay sends every transaction to a HostFlash, keeping the gaps between transactions. Waits are
+// replayed by polling the model until it is ready, at the spacing the trace shows. The per-transaction and
+// per-byte overhead of the MCU is fitted from the trace first, so the recorded settings replay close to the
+// recorded time and the other rows show what changing one setting would save.
+
+#include <SPIFlash.h>
+#include "HostFlash.h"
+#include <unistd.h>
+
+#define TRACE_MAXPOLLS  10000000UL   // Gives up replaying a wait after this many polls
+
+// One decoded FlashTraceEntry
+struct Entry {
+  uint32_t time, addr;
+  uint16_t len, duration;
+  uint8_t  opcode, status, op, flags;
+};
+
+// A run of consecutive status register reads
+struct Wait {
+  uint32_t first, last;   // Index of the first and last poll
+  bool     redundant;
+};
+
+static Entry *entries;
+static uint32_t count, recorded, jedec;
+static Wait *waits;
+static uint32_t waitCount;
+static const HostFlashProfile *profile;
+static uint32_t recordClock = SPI_CLK;
+
+static const HostFlashProfile *findProfile(const char *name) {
+  static const HostFlashProfile *const _profiles[] = { &hostFlashInstant, &hostFlashW25Q64, &hostFlashSST26, &hostFlashS25FL };
+  static const char *const _names[] = { "instant", "w25q64", "sst26", "s25fl" };
+  for (uint8_t i = 0; i < arrayLen(_names); i++) {
+    if (!strcmp(name, _names[i])) {
+      return _profiles[i];
+    }
+  }
+  return NULL;
+}
+
+// Returns the profile whose JEDEC ID matches the one in the dump. The capacity byte is not compared,
+// as Winbond and Cypress number their parts by capacity
+static const HostFlashProfile *matchProfile(uint32_t id) {
+  static const HostFlashProfile *const _profiles[] = { &hostFlashW25Q64, &hostFlashSST26, &hostFlashS25FL };
+  for (uint8_t i = 0; i < arrayLen(_profiles); i++) {
+    if (_profiles[i]->manufacturerID == (id >> 16) && _profiles[i]->memoryTypeID == ((id >> 8) & 0xFF)) {
+      return _profiles[i];
+    }
+  }
+  return &hostFlashW25Q64;
+}
+
+static const char *opcodeName(uint8_t opcode) {
+  switch (opcode) {
+    case JEDEC_READ_DATA:                 return "read";
+    case JEDEC_READ_FAST:                 return "fast read";
+    case JEDEC_PROG_BYTE:                 return "page program";
+    case JEDEC_ERASE_SECTOR:              return "sector erase";
+    case JEDEC_ERASE_BLOCK_32:            return "32K block erase";
+    case JEDEC_ERASE_BLOCK_64:            return "64K block erase";
+    case JEDEC_ERASE_CHIP:
+    case 0xC7:                            return "chip erase";
+    case JEDEC_READ_STATREG:              return "read status 1";
+    case WINBOND_READ_STATREG_2:          return "read status 2";
+    case WINBOND_READ_STATREG_3:          return "read status 3";
+    case JEDEC_PROG_STATREG:              return "write status";
+    case JEDEC_SET_WRITE_ENABLE:          return "write enable";
+    case JEDEC_SET_WRITE_DISABLE:         return "write disable";
+    case JEDEC_SET_WRITE_STATREG_ENABLE:  return "status write enable";
+    case JEDEC_SET_4_BYTE_ADDR_ENABLE:    return "enter 4-byte mode";
+    case JEDEC_SET_4_BYTE_ADDR_DISABLE:   return "exit 4-byte mode";
+    case JEDEC_SET_SUSPEND:
+    case MICROCHIP_SET_SUSPEND:           return "suspend";
+    case JEDEC_SET_RESUME:
+    case MICROCHIP_SET_RESUME:            return "resume";
+    case JEDEC_SET_POWERDOWN:             return "power down";
+    case JEDEC_SET_RELEASE:               return "release power down";
+    case JEDEC_READ_JEDECID:              return "read JEDEC ID";
+    case JEDEC_READ_MANSIG:               return "read manufacturer ID";
+    case JEDEC_READ_SFDP:                 return "read SFDP";
+    case JEDEC_READ_UNIQUE_ID:            return "read unique ID";
+    case ULBPR:                           return "global unlock";
+    default:                              return "?";
+  }
+}
+
+// Returns true if the opcode is followed by an address
+static bool takesAddress(uint8_t opcode) {
+  switch (opcode) {
+    case JEDEC_READ_DATA:
+    case JEDEC_READ_FAST:
+    case JEDEC_READ_SFDP:
+    case JEDEC_PROG_BYTE:
+    case JEDEC_ERASE_SECTOR:
+    case JEDEC_ERASE_BLOCK_32:
+    case JEDEC_ERASE_BLOCK_64:
+    return true;
+  }
+  return false;
+}
+
+// Returns true if the opcode can leave the chip busy
+static bool makesBusy(uint8_t opcode) {
+  switch (opcode) {
+    case JEDEC_PROG_BYTE:
+    case JEDEC_PROG_STATREG:
+    case JEDEC_ERASE_SECTOR:
+    case JEDEC_ERASE_BLOCK_32:
+    case JEDEC_ERASE_BLOCK_64:
+    case JEDEC_ERASE_CHIP:
+    case 0xC7:
+    case JEDEC_SET_RESUME:
+    case MICROCHIP_SET_RESUME:
+    return true;
+  }
+  return false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                              Decoding                              //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Reads 'bytes' bytes of hex, least significant byte first. Returns false if p does not hold that many hex digits
+static bool hexLE(const char *&p, uint8_t bytes, uint32_t &value) {
+  value = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    char _hex[3] = { p[0], p[1], 0 };
+    char *_end;
+    if (!isxdigit(p[0]) || !isxdigit(p[1])) {
+      return false;
+    }
+    value |= strtoul(_hex, &_end, 16) << (8 * i);
+    p += 2;
+  }
+  return true;
+}
+
+static bool parseEntry(const char *p, Entry &e) {
+  uint32_t _v[8];
+  const uint8_t _sizes[8] = { 4, 4, 2, 2, 1, 1, 1, 1 };
+  for (uint8_t i = 0; i < 8; i++) {
+    if (!hexLE(p, _sizes[i], _v[i])) {
+      return false;
+    }
+  }
+  e.time = _v[0];
+  e.addr = _v[1];
+  e.len = _v[2];
+  e.duration = _v[3];
+  e.opcode = _v[4];
+  e.status = _v[5];
+  e.op = _v[6];
+  e.flags = _v[7];
+  return true;
+}
+
+// Reads the last complete dump in the file into entries[]. Returns false if there is none
+static bool load(FILE *in) {
+  char _line[256];
+  Entry *_dump = NULL;
+  uint32_t _n = 0, _size = 0, _recorded = 0, _jedec = 0;
+  bool _inDump = false;
+  while (fgets(_line, sizeof(_line), in)) {
+    const char *_p;
+    unsigned _format, _id, _rec, _ents;
+    if ((_p = strstr(_line, "#FLASHTRACE")) && sscanf(_p, "#FLASHTRACE %u jedec=%x recorded=%u entries=%u", &_format, &_id, &_rec, &_ents) == 4) {
+      if (_format != TRACE_FORMAT) {
+        fprintf(stderr, "flashtrace: skipping dump in unknown format %u\n", _format);
+        _inDump = false;
+        continue;
+      }
+      _inDump = true;
+      _n = 0;
+      _recorded = _rec;
+      _jedec = _id;
+    }
+    else if (_inDump && strstr(_line, "#END")) {
+      free(entries);
+      entries = _dump;
+      count = _n;
+      recorded = _recorded;
+      jedec = _jedec;
+      _dump = NULL;
+      _size = 0;
+      _inDump = false;
+    }
+    else if (_inDump) {
+      Entry _e;
+      if (!parseEntry(_line, _e)) {
+        continue;
+      }
+      if (_n == _size) {
+        _size = _size ? _size * 2 : 256;
+        _dump = (Entry *)realloc(_dump, _size * sizeof(Entry));
+      }
+      _dump[_n++] = _e;
+    }
+  }
+  free(_dump);
+  return entries != NULL;
+}
+
+// Returns the time between the end of transaction i and the start of the next one - in uS
+static uint32_t gapAfter(uint32_t i) {
+  if (i + 1 >= count) {
+    return 0;
+  }
+  uint32_t _gap = entries[i + 1].time - (entries[i].time + entries[i].duration);
+  return (_gap & 0x80000000) ? 0 : _gap;      // The next transaction started within the micros() resolution
+}
+
+// Groups consecutive status register reads into waits and marks the redundant ones
+static void findWaits() {
+  waits = (Wait *)malloc((count ? count : 1) * sizeof(Wait));
+  waitCount = 0;
+  bool _mayBeBusy = true;        // Nothing is known about the chip before the first poll
+  for (uint32_t i = 0; i < count; i++) {
+    if (entries[i].opcode != JEDEC_READ_STATREG) {
+      if (makesBusy(entries[i].opcode)) {
+        _mayBeBusy = true;
+      }
+      continue;
+    }
+    Wait &_w = waits[waitCount++];
+    _w.first = i;
+    while (i + 1 < count && entries[i + 1].opcode == JEDEC_READ_STATREG) {
+      i++;
+    }
+    _w.last = i;
+    _w.redundant = !_mayBeBusy && !(entries[_w.first].status & BUSY);
+    _mayBeBusy = entries[_w.last].status & BUSY;
+  }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                              Analysis                              //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+struct Tally {
+  uint32_t count;
+  uint64_t bytes, busUs, gapUs;
+};
+
+static void printTally(const char *name, const Tally &t, uint64_t span) {
+  uint64_t _us = t.busUs + t.gapUs;
+  printf("  %-22s %8u %10llu %10llu %10llu %6.1f%%\n", name, (unsigned)t.count, (unsigned long long)t.bytes,
+         (unsigned long long)t.busUs, (unsigned long long)t.gapUs, span ? 100.0 * _us / span : 0);
+}
+
+static uint64_t traceSpan() {
+  return count ? (uint64_t)(entries[count - 1].time + entries[count - 1].duration - entries[0].time) : 0;
+}
+
+static void summary() {
+  printf("%u transactions", (unsigned)count);
+  if (recorded > count) {
+    printf(" (the first %u were overwritten in the ring)", (unsigned)(recorded - count));
+  }
+  printf(" from JEDEC ID %06X over %.3f ms\n\n", (unsigned)jedec, traceSpan() / 1000.0);
+}
+
+static void byOpcode() {
+  static Tally _t[256];
+  uint64_t _span = traceSpan();
+  for (uint32_t i = 0; i < count; i++) {
+    Tally &_o = _t[entries[i].opcode];
+    _o.count++;
+    _o.bytes += entries[i].len;
+    _o.busUs += entries[i].duration;
+    _o.gapUs += gapAfter(i);
+  }
+  printf("Time by opcode\n");
+  printf("  %-22s %8s %10s %10s %10s %7s\n", "opcode", "count", "bytes", "bus_us", "gap_us", "share");
+  // Largest share first
+  for (;;) {
+    int _max = -1;
+    for (int o = 0; o < 256; o++) {
+      if (_t[o].count && (_max < 0 || _t[o].busUs + _t[o].gapUs > _t[_max].busUs + _t[_max].gapUs)) {
+        _max = o;
+      }
+    }
+    if (_max < 0) {
+      break;
+    }
+    char _name[40];
+    snprintf(_name, sizeof(_name), "%02X %s", _max, opcodeName(_max));
+    printTally(_name, _t[_max], _span);
+    _t[_max].count = 0;
+  }
+  printf("\n");
+}
+
+static void byCaller() {
+  static const char *const _names[STATS_OPTYPES] = { "read functions", "write functions", "erase functions", "control / other" };
+  Tally _t[STATS_OPTYPES];
+  memset(_t, 0, sizeof(_t));
+  for (uint32_t i = 0; i < count; i++) {
+    Tally &_o = _t[entries[i].op < STATS_OPTYPES ? entries[i].op : STATS_CONTROL];
+    _o.count++;
+    _o.bytes += entries[i].len;
+    _o.busUs += entries[i].duration;
+    _o.gapUs += gapAfter(i);
+  }
+  printf("Time by caller\n");
+  printf("  %-22s %8s %10s %10s %10s %7s\n", "caller", "count", "bytes", "bus_us", "gap_us", "share");
+  for (uint8_t i = 0; i < STATS_OPTYPES; i++) {
+    printTally(_names[i], _t[i], traceSpan());
+  }
+  printf("\n");
+}
+
+static void polls() {
+  uint32_t _waits = 0, _polls = 0, _maxPolls = 0, _redundant = 0, _redundantPolls = 0;
+  uint64_t _waitUs = 0, _redundantUs = 0;
+  for (uint32_t w = 0; w < waitCount; w++) {
+    const Wait &_w = waits[w];
+    uint32_t _n = _w.last - _w.first + 1;
+    uint64_t _us = entries[_w.last].time + entries[_w.last].duration - entries[_w.first].time;
+    if (_w.redundant) {
+      _redundant++;
+      _redundantPolls += _n;
+      _redundantUs += _us;
+    }
+    else {
+      _waits++;
+      _polls += _n;
+      _waitUs += _us;
+      if (_n > _maxPolls) {
+        _maxPolls = _n;
+      }
+    }
+  }
+  printf("Status polls\n");
+  printf("  Waits for a busy chip:  %u, %u polls (mean %.1f, max %u), %.3f ms\n", (unsigned)_waits, (unsigned)_polls,
+         _waits ? (double)_polls / _waits : 0, (unsigned)_maxPolls, _waitUs / 1000.0);
+  printf("  Redundant waits:        %u, %u polls, %.3f ms - the chip could not have been busy\n",
+         (unsigned)_redundant, (unsigned)_redundantPolls, _redundantUs / 1000.0);
+  printf("\n");
+}
+
+static void addressMode() {
+  uint32_t _enter = 0, _exit = 0;
+  uint64_t _us = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (entries[i].opcode == JEDEC_SET_4_BYTE_ADDR_ENABLE || entries[i].opcode == JEDEC_SET_4_BYTE_ADDR_DISABLE) {
+      (entries[i].opcode == JEDEC_SET_4_BYTE_ADDR_ENABLE) ? _enter++ : _exit++;
+      _us += entries[i].duration + gapAfter(i);
+    }
+  }
+  printf("4-byte address mode\n");
+  printf("  Toggles:                %u enter, %u exit, %.3f ms\n\n", (unsigned)_enter, (unsigned)_exit, _us / 1000.0);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                               Replay                               //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+struct Settings {
+  const char *name;
+  uint32_t clock;
+  bool     dropRedundant;   // Skip redundant waits
+  bool     stay4Byte;       // Enter 4-byte mode once and stay there
+};
+
+// Returns the number of address and dummy bytes sent after the opcode
+static uint8_t headerBytes(uint8_t opcode, bool fourByte) {
+  if (!takesAddress(opcode)) {
+    return 0;
+  }
+  uint8_t _n = fourByte ? 4 : 3;
+  return (opcode == JEDEC_READ_FAST || opcode == JEDEC_READ_SFDP) ? _n + 1 : _n;
+}
+
+// Clocks one transaction through the chip and returns the first data byte read back
+static uint8_t send(const Entry &e, bool fourByte) {
+  uint8_t _hdr = headerBytes(e.opcode, fourByte);
+  uint8_t _addrBytes = takesAddress(e.opcode) ? (fourByte ? 4 : 3) : 0;
+  uint8_t _first = 0xFF;
+  digitalWrite(CS, LOW);
+  HostFlash::transfer(e.opcode);
+  for (uint8_t i = 0; i < _hdr; i++) {
+    HostFlash::transfer(i < _addrBytes ? e.addr >> (8 * (_addrBytes - 1 - i)) : DUMMYBYTE);
+  }
+  // 0xFF leaves programmed bytes - and the protection bits in a status register write - unchanged
+  uint8_t _out = (e.opcode == JEDEC_PROG_BYTE) ? 0xFF : (e.opcode == JEDEC_PROG_STATREG) ? 0x00 : NULLBYTE;
+  for (uint32_t i = 0; i < e.len; i++) {
+    uint8_t _in = HostFlash::transfer(_out);
+    if (!i) {
+      _first = _in;
+    }
+  }
+  digitalWrite(CS, HIGH);
+  return _first;
+}
+
+// Returns the mean time between the polls of a wait - in nS. Falls back to the mean over all waits for single polls
+static uint64_t pollSpacing(const Wait &w, uint64_t fallback) {
+  if (w.last == w.first) {
+    return fallback;
+  }
+  uint64_t _us = 0;
+  for (uint32_t i = w.first; i < w.last; i++) {
+    _us += gapAfter(i);
+  }
+  return _us * 1000 / (w.last - w.first);
+}
+
+// Replays the trace with the given settings and returns the time it takes - in nS
+static uint64_t replay(const Settings &s, uint32_t capacity) {
+  char _path[] = "/tmp/flashtraceXXXXXX";
+  int _fd = mkstemp(_path);
+  if (_fd < 0) {
+    return 0;
+  }
+  ::close(_fd);
+  unlink(_path);
+  HostFlash _chip(CS, *profile);
+  if (!_chip.open(_path, capacity)) {
+    unlink(_path);
+    return 0;
+  }
+  unlink(_path);
+  HostFlash::setClock(s.clock);
+
+  uint64_t _fallback = 0;
+  uint32_t _spaced = 0;
+  for (uint32_t w = 0; w < waitCount; w++) {
+    if (waits[w].last > waits[w].first) {
+      _fallback += pollSpacing(waits[w], 0);
+      _spaced++;
+    }
+  }
+  _fallback = _spaced ? _fallback / _spaced : 0;
+
+  uint64_t _start = hostNanos();
+  bool _fourByte = false;
+  uint32_t _w = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const Entry &_e = entries[i];
+    if (_e.opcode == JEDEC_READ_STATREG) {
+      while (waits[_w].first != i) {
+        _w++;
+      }
+      const Wait &_wait = waits[_w];
+      i = _wait.last;
+      if (!(_wait.redundant && s.dropRedundant)) {
+        uint64_t _spacing = pollSpacing(_wait, _fallback);
+        for (uint32_t p = 0; p < TRACE_MAXPOLLS && (send(_e, _fourByte) & BUSY); p++) {
+          hostAdvance(_spacing);
+        }
+      }
+      hostAdvance((uint64_t)gapAfter(i) * 1000);
+      continue;
+    }
+    bool _skip = s.stay4Byte && ((_e.opcode == JEDEC_SET_4_BYTE_ADDR_ENABLE && _fourByte) || _e.opcode == JEDEC_SET_4_BYTE_ADDR_DISABLE);
+    if (!_skip) {
+      send(_e, _fourByte);
+      if (_e.opcode == JEDEC_SET_4_BYTE_ADDR_ENABLE || _e.opcode == JEDEC_SET_4_BYTE_ADDR_DISABLE) {
+        _fourByte = (_e.opcode == JEDEC_SET_4_BYTE_ADDR_ENABLE);
+      }
+    }
+    hostAdvance((uint64_t)gapAfter(i) * 1000);
+  }
+  uint64_t _elapsed = hostNanos() - _start;
+  _chip.close();
+  return _elapsed;
+}
+
+// Fits duration = a + b * bytes over all transactions by least squares, and sets the HostFlash bus overhead
+// to the part of a and b that the bus at the recorded clock does not account for
+static void calibrate() {
+  double _n = 0, _sx = 0, _sy = 0, _sxx = 0, _sxy = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    double _x = 1 + headerBytes(entries[i].opcode, entries[i].flags & TRACE_4BYTE) + entries[i].len;
+    double _y = entries[i].duration * 1000.0;
+    _n++;
+    _sx += _x;
+    _sy += _y;
+    _sxx += _x * _x;
+    _sxy += _x * _y;
+  }
+  double _det = _n * _sxx - _sx * _sx;
+  double _b = (_det > 0) ? (_n * _sxy - _sx * _sy) / _det : 0;
+  double _a = (_n > 0) ? (_sy - _b * _sx) / _n : 0;
+  double _byteNs = _b - 8e9 / recordClock;
+  HostFlash::setBusOverhead(_a > 0 ? _a : 0, _byteNs > 0 ? _byteNs : 0);
+  printf("Replay against %s - MCU overhead fitted as %.2f us per transaction and %.3f us per byte\n",
+         profile->name, (_a > 0 ? _a : 0) / 1000.0, (_byteNs > 0 ? _byteNs : 0) / 1000.0);
+}
+
+static void predict(uint32_t altClock) {
+  uint32_t _capacity = profile->capacity;
+  if (!profile->capacityID) {
+    uint32_t _top = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      if (takesAddress(entries[i].opcode) && entries[i].addr > _top) {
+        _top = entries[i].addr;
+      }
+    }
+    while (_capacity <= _top && _capacity < MB(32)) {
+      _capacity <<= 1;
+    }
+  }
+  calibrate();
+  Settings _settings[] = {
+    { "recorded settings",   recordClock, false, false },
+    { "other clock",         altClock,    false, false },
+    { "no redundant waits",  recordClock, true,  false },
+    { "stay in 4-byte mode", recordClock, false, true  },
+    { "all of the above",    altClock ? altClock : recordClock, true, true },
+  };
+  uint64_t _base = 0;
+  printf("  %-22s %10s %10s %8s\n", "settings", "clock_hz", "time_ms", "saving");
+  for (uint8_t i = 0; i < arrayLen(_settings); i++) {
+    const Settings &_s = _settings[i];
+    if (!_s.clock) {
+      continue;
+    }
+    uint64_t _ns = replay(_s, _capacity);
+    if (!i) {
+      _base = _ns;
+    }
+    printf("  %-22s %10u %10.3f %7.1f%%\n", _s.name, (unsigned)_s.clock, _ns / 1e6, _base ? 100.0 * ((double)_base - _ns) / _base : 0);
+  }
+  printf("  (recorded: %.3f ms)\n", traceSpan() / 1000.0);
+}
+
+int main(int argc, char **argv) {
+  uint32_t _altClock = 0;
+  int _opt;
+  while ((_opt = getopt(argc, argv, "p:c:k:")) != -1) {
+    switch (_opt) {
+      case 'p':
+      if (!(profile = findProfile(optarg))) {
+        fprintf(stderr, "flashtrace: unknown profile '%s'\n", optarg);
+        return 2;
+      }
+      break;
+
+      case 'c':
+      recordClock = strtoul(optarg, NULL, 0);
+      break;
+
+      case 'k':
+      _altClock = strtoul(optarg, NULL, 0);
+      break;
+
+      default:
+      fprintf(stderr, "usage: flashtrace [-p instant|w25q64|sst26|s25fl] [-c clock] [-k clock] [file]\n");
+      return 2;
+    }
+  }
+  FILE *_in = (optind < argc) ? fopen(argv[optind], "r") : stdin;
+  if (!_in) {
+    fprintf(stderr, "flashtrace: cannot open %s\n", argv[optind]);
+    return 1;
+  }
+  bool _ok = load(_in);
+  if (_in != stdin) {
+    fclose(_in);
+  }
+  if (!_ok || !count) {
+    fprintf(stderr, "flashtrace: no complete #FLASHTRACE dump found\n");
+    return 1;
+  }
+  if (!profile) {
+    profile = matchProfile(jedec);
+  }
+  if (!recordClock) {
+    recordClock = SPI_CLK;
+  }
+
+  findWaits();
+  summary();
+  byOpcode();
+  byCaller();
+  polls();
+  addressMode();
+  predict(_altClock);
+  return 0;
+}
@@ -0,0 +1,104 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Runs an Arduino sketch against a simulated chip and reports how long it would have taken on hardware.
+// Built by 'make sketch SKETCH=path/to/Sketch.ino'.
+//
+//    sketch [-p profile] [-c capacity] [-l loops] [image]
+//
+//    -p --> instant, w25q64 (default), sst26 or s25fl
+//    -c --> Capacity of a new image in bytes. Defaults to the capacity of the profile
+//    -l --> Number of times loop() is called after setup(). Defaults to 1
+//    image --> Image file backing the chip. Defaults to sketch.bin
+//
+// The sketch's Serial output goes to stderr and the report to stdout.
+
+#include <SPIFlash.h>
+#include "HostFlash.h"
+#include <unistd.h>
+
+void setup();
+void loop();
+
+// The report goes to stdout, apart from the sketch's own output
+class StdoutPrint : public Print {
+public:
+  size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+  using  Print::write;
+};
+
+static const HostFlashProfile *findProfile(const char *name) {
+  static const HostFlashProfile *const _profiles[] = { &hostFlashInstant, &hostFlashW25Q64, &hostFlashSST26, &hostFlashS25FL };
+  static const char *const _names[] = { "instant", "w25q64", "sst26", "s25fl" };
+  for (uint8_t i = 0; i < arrayLen(_names); i++) {
+    if (!strcmp(name, _names[i])) {
+      return _profiles[i];
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  const HostFlashProfile *_profile = &hostFlashW25Q64;
+  uint32_t _capacity = 0;
+  unsigned long _loops = 1;
+  int _opt;
+  while ((_opt = getopt(argc, argv, "p:c:l:")) != -1) {
+    switch (_opt) {
+      case 'p':
+      _profile = findProfile(optarg);
+      if (!_profile) {
+        fprintf(stderr, "sketch: unknown profile '%s'\n", optarg);
+        return 2;
+      }
+      break;
+
+      case 'c':
+      _capacity = strtoul(optarg, NULL, 0);
+      break;
+
+      case 'l':
+      _loops = strtoul(optarg, NULL, 0);
+      break;
+
+      default:
+      fprintf(stderr, "usage: sketch [-p instant|w25q64|sst26|s25fl] [-c capacity] [-l loops] [image]\n");
+      return 2;
+    }
+  }
+
+  HostFlash _chip(CS, *_profile);
+  if (!_chip.open(optind < argc ? argv[optind] : "sketch.bin", _capacity)) {
+    fprintf(stderr, "sketch: cannot map image\n");
+    return 1;
+  }
+  setup();
+  for (unsigned long i = 0; i < _loops; i++) {
+    loop();
+  }
+
+  StdoutPrint _report;
+  _chip.report(_report);
+  return 0;
+}
@@ -0,0 +1,409 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "CompressedFlash.h"
+
+#define CFLASH_MINMATCH     3
+#define CFLASH_MAXMATCH     (CFLASH_MINMATCH + 15 + 255)
+#define CFLASH_NOBLOCK      0xFFFFFFFF
+#define CFLASH_READCHUNK    32
+
+// Hashes the three bytes at p into an index for the match table
+static uint8_t _hashOf(const uint8_t *p) {
+  uint32_t _v = p[0] | ((uint16_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+  return (uint8_t)((_v * 2654435761UL) >> 24);
+}
+
+// Feeds a compressed block to the decoder in small chunks so the whole block never has to be held in RAM
+struct cflashSource {
+  FlashWriter *writer;
+  uint32_t addr;
+  uint8_t  pos, len;
+  uint8_t  buf[CFLASH_READCHUNK];
+};
+
+static bool _nextSourceByte(cflashSource &src, uint32_t endAddr, uint8_t &data) {
+  if (src.pos == src.len) {
+    if (src.addr >= endAddr) {
+      return false;
+    }
+    src.len = (endAddr - src.addr > CFLASH_READCHUNK) ? CFLASH_READCHUNK : endAddr - src.addr;
+    if (!src.writer->read(src.addr, src.buf, src.len)) {
+      return false;
+    }
+    src.addr += src.len;
+    src.pos = 0;
+  }
+  data = src.buf[src.pos++];
+  return true;
+}
+
+// Constructor
+//  Takes four arguments -
+//    1. flash --> The SPIFlash object to store the data in. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the compressed blocks
+//    3. size --> Size of the region - in number of bytes
+//    4. errorCheck --> Turned on by default. Checks every block for writing errors
+CompressedFlash::CompressedFlash(SPIFlash &flash, uint32_t startAddr, uint32_t size, bool errorCheck) : _writer(flash, startAddr, size, errorCheck) {
+  _flash = &flash;
+  _errorCheck = errorCheck;
+  _startAddr = startAddr;
+  _endAddr = startAddr + size;
+  _length = 0;
+  _fill = 0;
+  _indexCount = 0;
+  _indexStride = 1;
+  _blockCount = 0;
+  _cachedBlock = CFLASH_NOBLOCK;
+}
+
+// Walks the block headers already in the region to rebuild the block index and find the end of the stored data.
+// Must be called before the first write or read. Returns false if the region could not be read.
+bool CompressedFlash::begin() {
+  uint16_t _rawLen, _storedLen;
+  bool     _isRaw;
+  uint32_t _frontier = _startAddr;
+  _writer = FlashWriter(*_flash, _startAddr, _endAddr - _startAddr, _errorCheck);
+  _length = 0;
+  _fill = 0;
+  _indexCount = 0;
+  _indexStride = 1;
+  _blockCount = 0;
+  _cachedBlock = CFLASH_NOBLOCK;
+  while (_frontier + CFLASH_HEADERSIZE <= _endAddr && _readBlock(_frontier, _rawLen, _storedLen, _isRaw)) {
+    _addIndex(_frontier, _length);
+    _length += _rawLen;
+    _frontier += CFLASH_HEADERSIZE + _storedLen;
+  }
+  _writer = FlashWriter(*_flash, _frontier, _endAddr - _frontier, _errorCheck);
+  return _flash->getCapacity() && _endAddr <= _flash->getCapacity();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Reads the header of the block at addr. Returns false if there is no valid block at addr.
+bool CompressedFlash::_readBlock(uint32_t addr, uint16_t &rawLen, uint16_t &storedLen, bool &isRaw) {
+  uint8_t _header[CFLASH_HEADERSIZE];
+  if (!_writer.read(addr, _header, CFLASH_HEADERSIZE)) {
+    return false;
+  }
+  storedLen = _header[0] | (_header[1] << 8);
+  rawLen = _header[2] | (_header[3] << 8);
+  if (storedLen == 0xFFFF || !rawLen || rawLen > CFLASH_BLOCKSIZE) {
+    return false;
+  }
+  isRaw = storedLen & CFLASH_RAWBLOCK;
+  storedLen &= ~CFLASH_RAWBLOCK;
+  return storedLen <= rawLen && addr + CFLASH_HEADERSIZE + storedLen <= _endAddr;
+}
+
+// Records the address of every _indexStride'th block. When the index is full every other entry is
+// dropped and the stride is doubled, so the index covers any number of blocks in fixed RAM.
+void CompressedFlash::_addIndex(uint32_t addr, uint32_t offset) {
+  if (!(_blockCount % _indexStride)) {
+    if (_indexCount == CFLASH_INDEXSIZE) {
+      for (uint16_t i = 0; i < CFLASH_INDEXSIZE / 2; i++) {
+        _index[i] = _index[i * 2];
+      }
+      _indexCount = CFLASH_INDEXSIZE / 2;
+      _indexStride *= 2;
+    }
+    if (!(_blockCount % _indexStride)) {
+      _index[_indexCount].addr = addr;
+      _index[_indexCount].offset = offset;
+      _indexCount++;
+    }
+  }
+  _blockCount++;
+}
+
+// Compresses inLen bytes from in into out. The output is a sequence of groups, each made of a control byte
+// followed by eight items. A clear control bit marks a literal byte, a set bit marks a two byte match holding a
+// 12-bit distance and a 4-bit length, with a third byte extending the length of long matches.
+// Returns the compressed size, or 0 if the data would not compress to fewer than outMax bytes.
+uint16_t CompressedFlash::_compress(const uint8_t *in, uint16_t inLen, uint8_t *out, uint16_t outMax) {
+  uint16_t _in = 0, _out = 0, _ctrlPos = 0;
+  uint8_t  _ctrlBit = 8;
+  memset(_hash, 0, sizeof(_hash));
+
+  while (_in < inLen) {
+    if (_ctrlBit == 8) {
+      if (_out >= outMax) {
+        return 0;
+      }
+      _ctrlPos = _out++;
+      out[_ctrlPos] = 0;
+      _ctrlBit = 0;
+    }
+
+    uint16_t _matchLen = 0, _matchDist = 0;
+    if (_in + CFLASH_MINMATCH <= inLen) {
+      uint8_t _h = _hashOf(&in[_in]);
+      uint16_t _candidate = _hash[_h];
+      _hash[_h] = _in + 1;
+      if (_candidate--) {
+        uint16_t _max = inLen - _in;
+        if (_max > CFLASH_MAXMATCH) {
+          _max = CFLASH_MAXMATCH;
+        }
+        while (_matchLen < _max && in[_candidate + _matchLen] == in[_in + _matchLen]) {
+          _matchLen++;
+        }
+        _matchDist = _in - _candidate;
+      }
+    }
+
+    if (_matchLen >= CFLASH_MINMATCH) {
+      uint8_t _lenCode = (_matchLen - CFLASH_MINMATCH >= 15) ? 15 : _matchLen - CFLASH_MINMATCH;
+      if (_out + 2 + (_lenCode == 15) >= outMax) {
+        return 0;
+      }
+      out[_ctrlPos] |= (1 << _ctrlBit);
+      out[_out++] = (_matchDist - 1) >> 4;
+      out[_out++] = ((_matchDist - 1) << 4) | _lenCode;
+      if (_lenCode == 15) {
+        out[_out++] = _matchLen - CFLASH_MINMATCH - 15;
+      }
+      for (uint16_t k = 1; k < _matchLen && _in + k + CFLASH_MINMATCH <= inLen; k++) {
+        _hash[_hashOf(&in[_in + k])] = _in + k + 1;
+      }
+      _in += _matchLen;
+    }
+    else {
+      if (_out >= outMax) {
+        return 0;
+      }
+      out[_out++] = in[_in++];
+    }
+    _ctrlBit++;
+  }
+  return (_out < outMax) ? _out : 0;
+}
+
+// Compresses the buffered data and programs it as one block. Data that does not compress is stored as is.
+bool CompressedFlash::_writeBlock() {
+  if (!_fill) {
+    return true;
+  }
+  uint16_t _stored = _compress(_raw, _fill, &_block[CFLASH_HEADERSIZE], _fill);
+  uint16_t _storedField = _stored;
+  if (!_stored) {
+    memcpy(&_block[CFLASH_HEADERSIZE], _raw, _fill);
+    _stored = _fill;
+    _storedField = _fill | CFLASH_RAWBLOCK;
+  }
+  _cachedBlock = CFLASH_NOBLOCK;
+  uint32_t _blockSize = CFLASH_HEADERSIZE + (uint32_t)_stored;
+  if (_blockSize > _writer.remaining()) {
+    setWriteError();
+    return false;
+  }
+  _block[0] = _storedField & 0xFF;
+  _block[1] = _storedField >> 8;
+  _block[2] = _fill & 0xFF;
+  _block[3] = _fill >> 8;
+  uint32_t _blockAddr = _writer.position();
+  // A page program that fails part way leaves the start of the block in the flash. It is not indexed, but begin()
+  // finds its header after a restart and reads stop making sense from there on
+  if (_writer.write(_block, _blockSize) != _blockSize) {
+    setWriteError();
+    return false;
+  }
+  _addIndex(_blockAddr, _length - _fill);
+  _fill = 0;
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                       Write / Read functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Appends a single byte. Returns 1 if the byte was accepted, 0 if the region is full.
+size_t CompressedFlash::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+// Appends an array of bytes. A block is compressed and programmed every CFLASH_BLOCKSIZE bytes.
+// Returns the number of bytes accepted.
+size_t CompressedFlash::write(const uint8_t *buffer, size_t size) {
+  size_t _written = 0;
+  while (_written < size) {
+    uint16_t _chunk = CFLASH_BLOCKSIZE - _fill;
+    if (_chunk > size - _written) {
+      _chunk = size - _written;
+    }
+    memcpy(&_raw[_fill], &buffer[_written], _chunk);
+    _fill += _chunk;
+    _length += _chunk;
+    _written += _chunk;
+    if (_fill == CFLASH_BLOCKSIZE && !_writeBlock()) {
+      _fill -= _chunk;
+      _length -= _chunk;
+      _written -= _chunk;
+      break;
+    }
+  }
+  return _written;
+}
+
+// Compresses whatever data is buffered as a (short) block of its own and programs any partial page.
+void CompressedFlash::flush() {
+  if (_writeBlock()) {
+    _writer.flush();
+  }
+}
+
+// Reads uncompressed data back from any offset. Data that has not been flushed yet is read from RAM.
+//  Takes three arguments -
+//    1. offset --> Offset of the first byte in the uncompressed data
+//    2. buffer --> Buffer to read the data into
+//    3. size --> Number of bytes to read
+bool CompressedFlash::read(uint32_t offset, void *buffer, size_t size) {
+  uint8_t *_out = (uint8_t*)buffer;
+  if (offset + size > _length) {
+    return false;
+  }
+  while (size) {
+    uint32_t _flushedLength = _length - _fill;
+    uint32_t _blockOffset, _blockAddr;
+    uint16_t _rawLen, _storedLen;
+    bool     _isRaw;
+    const uint8_t *_data;
+
+    if (offset >= _flushedLength) {
+      _blockOffset = _flushedLength;
+      _rawLen = _fill;
+      _data = _raw;
+    }
+    else {
+      // Start from the last index entry before offset and walk the block headers from there
+      uint16_t k = _indexCount - 1;
+      while (k && _index[k].offset > offset) {
+        k--;
+      }
+      _blockAddr = _index[k].addr;
+      _blockOffset = _index[k].offset;
+      while (true) {
+        if (!_readBlock(_blockAddr, _rawLen, _storedLen, _isRaw)) {
+          return false;
+        }
+        if (offset < _blockOffset + _rawLen) {
+          break;
+        }
+        _blockOffset += _rawLen;
+        _blockAddr += CFLASH_HEADERSIZE + _storedLen;
+      }
+
+      if (_cachedBlock != _blockAddr) {
+        _cachedBlock = CFLASH_NOBLOCK;
+        if (_isRaw) {
+          if (!_writer.read(_blockAddr + CFLASH_HEADERSIZE, _block, _rawLen)) {
+            return false;
+          }
+        }
+        else {
+          cflashSource _src;
+          _src.writer = &_writer;
+          _src.addr = _blockAddr + CFLASH_HEADERSIZE;
+          _src.pos = _src.len = 0;
+          uint32_t _srcEnd = _src.addr + _storedLen;
+          uint16_t _decoded = 0;
+          uint8_t _ctrl = 0, _ctrlBit = 8, _b0, _b1, _b2;
+          while (_decoded < _rawLen) {
+            if (_ctrlBit == 8) {
+              if (!_nextSourceByte(_src, _srcEnd, _ctrl)) {
+                return false;
+              }
+              _ctrlBit = 0;
+            }
+            if (_ctrl & (1 << _ctrlBit)) {
+              if (!_nextSourceByte(_src, _srcEnd, _b0) || !_nextSourceByte(_src, _srcEnd, _b1)) {
+                return false;
+              }
+              uint16_t _dist = ((_b0 << 4) | (_b1 >> 4)) + 1;
+              uint16_t _len = (_b1 & 0x0F) + CFLASH_MINMATCH;
+              if ((_b1 & 0x0F) == 15) {
+                if (!_nextSourceByte(_src, _srcEnd, _b2)) {
+                  return false;
+                }
+                _len += _b2;
+              }
+              if (_dist > _decoded || _decoded + _len > _rawLen) {
+                return false;
+              }
+              while (_len--) {
+                _block[_decoded] = _block[_decoded - _dist];
+                _decoded++;
+              }
+            }
+            else {
+              if (!_nextSourceByte(_src, _srcEnd, _block[_decoded])) {
+                return false;
+              }
+              _decoded++;
+            }
+            _ctrlBit++;
+          }
+        }
+        _cachedBlock = _blockAddr;
+      }
+      _data = _block;
+    }
+
+    uint32_t _chunk = _blockOffset + _rawLen - offset;
+    if (_chunk > size) {
+      _chunk = size;
+    }
+    memcpy(_out, &_data[offset - _blockOffset], _chunk);
+    _out += _chunk;
+    offset += _chunk;
+    size -= _chunk;
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                       Information functions                        //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of uncompressed bytes stored, including any that have not been flushed yet
+uint32_t CompressedFlash::size() {
+  return _length;
+}
+
+// Returns the number of bytes of the region taken up by the compressed blocks
+uint32_t CompressedFlash::used() {
+  return _writer.position() - _startAddr;
+}
+
+// Returns the compression ratio achieved so far (uncompressed bytes per byte programmed)
+float CompressedFlash::ratio() {
+  uint32_t _flushedLength = _length - _fill;
+  if (!used()) {
+    return 1;
+  }
+  return (float)_flushedLength / used();
+}
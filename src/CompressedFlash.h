@@ -0,0 +1,95 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPRESSEDFLASH_H
+#define COMPRESSEDFLASH_H
+
+#include "FlashWriter.h"
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//   Size of the uncompressed blocks and of the block index in RAM.   //
+//  Larger blocks compress better but need more RAM - roughly three   //
+//        times CFLASH_BLOCKSIZE plus 8 bytes per index entry         //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#ifndef CFLASH_BLOCKSIZE
+#define CFLASH_BLOCKSIZE    (2 * SPI_PAGESIZE)     // Must not exceed 4096
+#endif
+#ifndef CFLASH_INDEXSIZE
+#define CFLASH_INDEXSIZE    32
+#endif
+#define CFLASH_HEADERSIZE   4
+#define CFLASH_RAWBLOCK     0x8000                 // Set in the stored length of blocks that did not compress
+#define CFLASH_HASHSIZE     256
+
+// Appends data to a region of the flash memory in compressed blocks and reads it back from any offset.
+// Data is collected in RAM until CFLASH_BLOCKSIZE bytes are available and is then compressed with a small
+// LZ77 coder and programmed as one block, so the number of bytes programmed (and the time spent programming
+// and erasing) shrinks with the compression ratio. Each block starts with a 4 byte header holding its stored
+// and uncompressed lengths. Blocks are packed back to back through a FlashWriter, so only full pages are
+// programmed. A sparse index of block addresses is kept in RAM for random reads and is rebuilt from the
+// block headers by begin().
+// WARNING: The region must be erased before it is first used (see eraseSection()). If programming a block fails,
+// getWriteError() is set and the part of the block already programmed stays in the flash - the data from that block on
+// cannot be read back after begin(). Erase the region and start again.
+class CompressedFlash : public Print {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  CompressedFlash(SPIFlash &flash, uint32_t startAddr, uint32_t size, bool errorCheck = true);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin();
+  //-------------------------------- Write / Read functions -----------------------------//
+  size_t   write(uint8_t data);
+  size_t   write(const uint8_t *buffer, size_t size);
+  using    Print::write;
+  void     flush();
+  bool     read(uint32_t offset, void *buffer, size_t size);
+  //-------------------------------- Information functions ------------------------------//
+  uint32_t size();
+  uint32_t used();
+  float    ratio();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _writeBlock();
+  bool     _readBlock(uint32_t addr, uint16_t &rawLen, uint16_t &storedLen, bool &isRaw);
+  void     _addIndex(uint32_t addr, uint32_t offset);
+  uint16_t _compress(const uint8_t *in, uint16_t inLen, uint8_t *out, uint16_t outMax);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  FlashWriter _writer;
+  bool        _errorCheck;
+  uint32_t    _startAddr, _endAddr, _length;
+  uint16_t    _fill, _indexCount, _indexStride, _blockCount;
+  uint32_t    _cachedBlock;                                   // Address of the block decoded into _block, 0xFFFFFFFF if none
+  struct      indexEntry {
+                uint32_t addr;
+                uint32_t offset;
+              };
+              indexEntry _index[CFLASH_INDEXSIZE];
+  uint8_t     _raw[CFLASH_BLOCKSIZE];                         // Data waiting to be compressed
+  uint8_t     _block[CFLASH_HEADERSIZE + CFLASH_BLOCKSIZE];   // Compressed block being written or decoded block being read
+  uint16_t    _hash[CFLASH_HASHSIZE];
+};
+
+#endif // COMPRESSEDFLASH_H
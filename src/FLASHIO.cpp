@@ -84,7 +84,7 @@ bool SPIFlash::_prep(uint8_t opcode, uint32_t _addr, uint32_t size) {
   switch (opcode) {
     case JEDEC_PROG_BYTE:
     #ifndef HIGHSPEED
-      if(_isChipPoweredDown() || !_addressCheck(_addr, size) || !_notPrevWritten(_addr, size) || !_notBusy() || !_writeEnable()) {
+      if(_isChipPoweredDown() || !_addressCheck(_addr, size) || !_notBusy() || (blankCheckEnabled && !_notPrevWritten(_addr, size)) || !_writeEnable()) {
         return false;
       }
     #else
@@ -102,8 +102,16 @@ bool SPIFlash::_prep(uint8_t opcode, uint32_t _addr, uint32_t size) {
     return true;
     break;
 
+    // A read that leads to a program - the program would be issued with the previous one still suspended
+    case PROGREADFUNC:
+    if (_isChipPoweredDown() || !_addressCheck(_addr, size) || !_notBusy()) {
+      return false;
+    }
+    return true;
+    break;
+
     default:
-      if (_isChipPoweredDown() || !_addressCheck(_addr, size) || !_notBusy()) {
+      if (_isChipPoweredDown() || !_addressCheck(_addr, size) || !_suspendForRead(_currentAddress, size)) {
         return false;
       }
     #ifdef ENABLEZERODMA
@@ -114,6 +122,89 @@ bool SPIFlash::_prep(uint8_t opcode, uint32_t _addr, uint32_t size) {
   }
 }
 
+// Fills order[] with the indices of the n segments in v, sorted by ascending address.
+// Insertion sort - segment lists are short and frequently already sorted.
+void SPIFlash::_sortIOVec(const FlashIOVec *v, size_t n, uint16_t *order) {
+  for (size_t i = 0; i < n; i++) {
+    size_t j = i;
+    while (j > 0 && v[order[j - 1]].addr > v[i].addr) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+}
+
+#ifdef ENABLESTATS
+// Returns the total number of bytes in the n segments in v. Used to account scatter-gather transfers in the statistics.
+uint32_t SPIFlash::_iovecBytes(const FlashIOVec *v, size_t n) {
+  uint32_t _total = 0;
+  for (size_t i = 0; i < n; i++) {
+    _total += v[i].len;
+  }
+  return _total;
+}
+#endif
+
+// Clocks the bytes from spanStart up to (but not including) spanEnd - which must lie within one page - through an
+// instruction that has already been started with _beginSPI(). Segment order[i] must contain spanStart.
+// Depending on the mode each byte is checked to be erased, programmed or checked against the segment data.
+// Bytes in the gaps between segments are programmed as 0xFF, which leaves whatever is stored there untouched.
+bool SPIFlash::_iovecSpan(const FlashIOVec *v, const uint16_t *order, size_t n, size_t i, uint32_t spanStart, uint32_t spanEnd, uint8_t mode) {
+  for (uint32_t _pos = spanStart; _pos < spanEnd; _pos++) {
+    while (i < n && _pos >= v[order[i]].addr + v[order[i]].len) {
+      i++;
+    }
+    if (i == n || _pos < v[order[i]].addr) {
+      if (mode == SPAN_PROGRAM) {
+        _nextByte(WRITE, 0xFF);
+      }
+      else {
+        _nextByte(READ);
+      }
+      continue;
+    }
+    uint8_t _data = v[order[i]].buffer[_pos - v[order[i]].addr];
+    switch (mode) {
+      case SPAN_BLANKCHECK:
+      if (_nextByte(READ) != 0xFF) {
+        CHIP_DESELECT
+        _troubleshoot(PREVWRITTEN);
+        return false;
+      }
+      break;
+
+      case SPAN_PROGRAM:
+      _nextByte(WRITE, _data);
+      break;
+
+      case SPAN_VERIFY:
+      if (_nextByte(READ) != _data) {
+        CHIP_DESELECT
+        _troubleshoot(ERRORCHKFAIL);
+        return false;
+      }
+      break;
+    }
+  }
+  CHIP_DESELECT
+  return true;
+}
+
+// Clocks up to one page of data out to the flash memory and starts programming it without waiting for the
+// program to complete - the next _prep() on this chip waits for it instead. The data must not cross a page boundary.
+bool SPIFlash::_pageProgram(uint32_t _addr, uint8_t *data_buffer, uint16_t size) {
+  if (!_prep(JEDEC_PROG_BYTE, _addr, size)) {
+    return false;
+  }
+  _beginSPI(JEDEC_PROG_BYTE);
+  for (uint16_t i = 0; i < size; ++i) {
+    _nextByte(WRITE, data_buffer[i]);
+  }
+  _endSPI();
+  return true;
+}
+
 // Transfer Address.
 bool SPIFlash::_transferAddress() {
   if (address4ByteEnabled) {
@@ -125,16 +216,25 @@ bool SPIFlash::_transferAddress() {
   return true;
 }
 
-bool SPIFlash::_startSPIBus() {
-  SPI.beginTransaction(_settings);
+// Starts an SPI transaction with the clock profile for fast reads or for every other command - see setFastReadClock()
+bool SPIFlash::_startSPIBus(bool fast) {
+  SPI.beginTransaction(fast ? _fastSettings : _settings);
+  _busFast = fast;
   SPIBusState = true;
   return true;
 }
 
 // Initiates SPI operation - but data is not transferred yet. Always call _prep() before this function (especially when it involves writing or reading to/from an address)
 bool SPIFlash::_beginSPI(uint8_t opcode) {
+  bool _fast = (opcode == JEDEC_READ_FAST);
+#ifdef SPI_HAS_TRANSACTION
+  if (SPIBusState && _fast != _busFast) {   // Switch to the clock profile of the command
+    SPI.endTransaction();
+    SPIBusState = false;
+  }
+#endif
   if (!SPIBusState) {
-    _startSPIBus();
+    _startSPIBus(_fast);
   }
 
   // SPI data lines are left open until _endSPI() is called
@@ -152,8 +252,8 @@ bool SPIFlash::_beginSPI(uint8_t opcode) {
 
     case JEDEC_READ_FAST:
     _nextByte(WRITE, opcode);
-    _nextByte(WRITE, DUMMYBYTE);
     _transferAddress();
+    _nextByte(WRITE, DUMMYBYTE);
     break;
 
     case JEDEC_ERASE_SECTOR:
@@ -181,11 +281,27 @@ bool SPIFlash::_beginSPI(uint8_t opcode) {
 
 //Reads/Writes next byte. Call 'n' times to read/write 'n' number of bytes. Should be called after _beginSPI()
 uint8_t SPIFlash::_nextByte(char IOType, uint8_t data) {
+  if (_opcodeNext) {
+    _cmdOpcode = data;
+  #if FLASHLOGLEVEL >= FLASHLOG_ERROR
+    _lastOpcode = data;
+  #endif
+    _opcodeNext = false;
+  }
+#ifdef ENABLETRACE
+  uint8_t _in = SPI.transfer(data);
+  _traceByte(data, _in);
+  return _in;
+#else
   return SPI.transfer(data);
+#endif
 }
 
 //Reads/Writes next int. Call 'n' times to read/write 'n' number of integers. Should be called after _beginSPI()
 uint16_t SPIFlash::_nextInt(uint16_t data) {
+#ifdef ENABLETRACE
+  _traceData(2);
+#endif
   return SPI.transfer16(data);
 }
 
@@ -194,17 +310,23 @@ void SPIFlash::_nextBuf(uint8_t opcode, uint8_t *data_buffer, uint32_t size) {
   uint8_t *_dataAddr = &(*data_buffer);
   switch (opcode) {
     case JEDEC_READ_DATA:
-      for (uint16_t i = 0; i < size; i++) {
+      for (uint32_t i = 0; i < size; i++) {
         *_dataAddr = SPI.transfer(NULLBYTE);
         _dataAddr++;
       }
+#ifdef ENABLETRACE
+      _traceData(size, data_buffer);
+#endif
       break;
 
     case JEDEC_PROG_BYTE:
-      for (uint16_t i = 0; i < size; i++) {
+      for (uint32_t i = 0; i < size; i++) {
         SPI.transfer(*_dataAddr);
         _dataAddr++;
       }
+#ifdef ENABLETRACE
+      _traceData(size);
+#endif
       break;
   }
 }
@@ -216,6 +338,10 @@ void SPIFlash::_endSPI() {
   if (address4ByteEnabled) {          // If the previous operation enabled 4-byte addressing, disable it
     _disable4ByteAddressing();
   }
+  if (_autoSuspended) {               // If a program or erase was suspended for the read, let it carry on
+    _autoSuspended = false;
+    _resume();
+  }
 
 #ifdef SPI_HAS_TRANSACTION
   SPI.endTransaction();
@@ -282,24 +408,94 @@ bool SPIFlash::_disable4ByteAddressing() {
   return true;
 }
 
-// Checks the erase/program suspend flag before enabling/disabling a program/erase suspend operation
-bool SPIFlash::_noSuspend() {
+// Returns true if a program or erase is suspended. SST26 parts report it in status register 1, Winbond and Cypress parts in status register 2
+bool SPIFlash::_isSuspended() {
   switch (_chip.manufacturerID) {
     case WINBOND_MANID:
-    if(_readStat2() & SUS) {
-      _troubleshoot(SYSSUSPEND);
-  		return false;
-    }
-  	return true;
+    case CYPRESS_MANID:
+    return _readStat2() & SUS;
     break;
 
     case MICROCHIP_MANID:
     _readStat1();
-    if(stat1 & WSE || stat1 & WSP) {
-      _troubleshoot(SYSSUSPEND);
-  		return false;
-    }
+    return (stat1 & WSE) || (stat1 & WSP);
+  }
+  return false;
+}
+
+// Returns true if the chip can suspend a program or erase and report that it has
+bool SPIFlash::_canSuspend() {
+  switch (_chip.manufacturerID) {
+    case WINBOND_MANID:
+    case CYPRESS_MANID:
+    return true;
+    break;
+
+    case MICROCHIP_MANID:
+    return _chip.memoryTypeID == MICROCHIP_SST26;
   }
+  return false;
+}
+
+// Suspends the program or erase in progress so that the chip can be read, setting its timing aside until _resume().
+// Returns false if the chip did not suspend it - usually because it completed in the meantime.
+bool SPIFlash::_suspend() {
+  _beginSPI((_chip.manufacturerID == MICROCHIP_MANID) ? MICROCHIP_SET_SUSPEND : JEDEC_SET_SUSPEND);
+  CHIP_DESELECT
+  _suspendStart = micros();
+  _busySuspended = _busyOp;
+  _busyOp = BUSY_NONE;
+  _busyStart = _suspendStart - _busyStart;     // Now holds the time the operation has run for
+  // Reads are accepted once the busy flag clears - within tSUS
+  if (_notBusy(SUSPEND_TSUS) && _isSuspended()) {
+    return true;
+  }
+  _busyOp = _busySuspended;
+  _busySuspended = BUSY_NONE;
+  _busyStart = micros() - _busyStart;
+  return false;
+}
+
+// Resumes the program or erase suspended by _suspend()
+void SPIFlash::_resume() {
+  _beginSPI((_chip.manufacturerID == MICROCHIP_MANID) ? MICROCHIP_SET_RESUME : JEDEC_SET_RESUME);
+  CHIP_DESELECT
+  _resumeTime = micros();
+  _suspendedFor += _resumeTime - _suspendStart;
+  if (_busySuspended != BUSY_NONE) {
+    _busyOp = _busySuspended;
+    _busySuspended = BUSY_NONE;
+    _busyStart = _resumeTime - _busyStart;
+  }
+}
+
+// Makes the chip ready for a read. A program or erase that is not close to completion is suspended - and resumed by
+// _endSPI() once the read is done - as long as it has not used up the budget set by setSuspendBudget(). Otherwise
+// waits for the chip like _notBusy(). A read from the page being programmed or the sector / block being erased always
+// waits - the data there is indeterminate while the operation is suspended.
+//  Takes two arguments -
+//    1. _addr --> Address of the first byte to be read
+//    2. size --> Number of bytes to be read
+bool SPIFlash::_suspendForRead(uint32_t _addr, uint32_t size) {
+  bool _overlaps = _addr < _busyAddr + _busySize && _busyAddr < _addr + size;
+  if (_autoSuspended) {
+    return !_overlaps || _notBusy();
+  }
+  if (_overlaps || _busyOp == BUSY_NONE || _busyOp == BUSY_CE || _suspendedFor >= _suspendBudget || !_canSuspend()) {
+    return _notBusy();
+  }
+  uint32_t _elapsed = micros() - _busyStart;
+  if ((_busyTyp[_busyOp] && _elapsed + SUSPEND_TRS >= _busyTyp[_busyOp]) || !(_readStat1() & BUSY)) {
+    return _notBusy();
+  }
+  uint32_t _sinceResume = micros() - _resumeTime;
+  if (_suspendedFor && _sinceResume < SUSPEND_TRS) {
+    _delay_us(SUSPEND_TRS - _sinceResume);
+  }
+  if (!_suspend()) {
+    return _notBusy();
+  }
+  _autoSuspended = true;
   return true;
 }
 
@@ -314,23 +510,220 @@ bool SPIFlash::_isChipPoweredDown() {
   }
 }
 
-// Polls the status register 1 until busy flag is cleared or timeout
+// Waits for the chip to finish a program or erase. If the library started one (see _commandEnd()), sleeps until
+// shortly before it is expected to complete and then polls the status register with backoff, giving up once it has
+// run for the longest time that operation can take. The time it took is folded into the running estimate for the
+// next one. Otherwise - the chip is normally idle - polls for up to timeout uS.
 bool SPIFlash::_notBusy(uint32_t timeout) {
+  if (_autoSuspended) {
+    _autoSuspended = false;
+    _resume();
+  }
   _delay_us(SPI_WRITE_DELAY);
-  uint32_t _time = micros();
-  do {
+  uint32_t _start = micros();
+  uint32_t _since = _start;
+  uint8_t _op = _busyOp;
+  bool _early = false;                // The wait started before the command was expected to complete
+  if (_op != BUSY_NONE) {
+    _since = _busyStart;
+    timeout = _busyMax[_op];
+    uint32_t _expect = _busyTyp[_op] - _busyTyp[_op] / BUSY_EARLY;
+    if (_start - _since < _expect) {
+      _sleep(_expect - (_start - _since));
+      _early = true;
+    }
+  }
+#ifdef ENABLESTATS
+  uint32_t _polls = 0;
+#endif
+  uint32_t _interval = BUSY_POLLMIN;
+  uint32_t _elapsed;
+  bool _ready, _sawBusy = false;
+  for (;;) {
     _readStat1();
-    if (!(stat1 & BUSY))
-    {
-      return true;
+#ifdef ENABLESTATS
+    _polls++;
+#endif
+    _elapsed = micros() - _since;
+    _ready = !(stat1 & BUSY);
+    _sawBusy = _sawBusy || !_ready;
+    if (_ready || _elapsed >= timeout) {
+      break;
     }
-    _time++;
-  } while ((micros() - _time) < timeout);
-  if (timeout <= (micros() - _time)) {
-    return false;
+    _sleep(_interval);
+    // Back off, but never so far that the wait overshoots the completion by more than an eighth
+    _interval = (_interval * 2 < _elapsed / 8) ? _interval * 2 : ((_elapsed / 8 > BUSY_POLLMIN) ? _elapsed / 8 : BUSY_POLLMIN);
   }
-  return true;
+  if (_op != BUSY_NONE) {
+    _busyOp = BUSY_NONE;
+    if (_ready) {
+      // Only learn from a wait that saw the command complete, or that slept until it was due. A chip that is
+      // found idle straight away may have finished long before anyone looked
+      if (_sawBusy || _early) {
+        uint32_t _sample = (_elapsed < _busyMax[_op]) ? _elapsed : _busyMax[_op];
+        _busyTyp[_op] = _busyTyp[_op] ? _busyTyp[_op] - _busyTyp[_op] / 4 + _sample / 4 : _sample;
+      }
+    }
+    else {
+      _troubleshoot(VOYNICH_STATUS_CHIPBUSY);
+    }
+  }
+#ifdef ENABLESTATS
+  _countBusyWait(_start, _polls);
+#endif
+  return _ready;
+}
+
+// Notes the time a program or erase was started, so that _notBusy() knows how long to wait for it. Called by
+// CHIP_DESELECT - the chip starts the command when it is deselected.
+void SPIFlash::_commandEnd() {
+  uint8_t _op;
+  uint32_t _size;
+  switch (_cmdOpcode) {
+    case JEDEC_PROG_BYTE:
+    _op = BUSY_PROG;
+    _size = SPI_PAGESIZE;
+    break;
+
+    case JEDEC_ERASE_SECTOR:
+    _op = BUSY_SE;
+    _size = KB(4);
+    break;
+
+    case JEDEC_ERASE_BLOCK_32:
+    _op = BUSY_BE32;
+    _size = KB(32);
+    break;
+
+    case JEDEC_ERASE_BLOCK_64:
+    _op = BUSY_BE64;
+    _size = KB(64);
+    break;
+
+    case JEDEC_ERASE_CHIP:
+    _op = BUSY_CE;
+    _size = 0;
+    break;
+
+    default:
+    _cmdOpcode = 0;
+    return;
+  }
+  _busyOp = _op;
+  // Memory the command works on - the page or the sector / block containing the address it was sent with
+  _busyAddr = _size ? _currentAddress - (_currentAddress % _size) : 0;
+  _busySize = _size ? _size : _chip.capacity;
+  _busyStart = micros();
+  _suspendedFor = 0;
+  _cmdOpcode = 0;
+}
+
+// Waits without using the SPI bus. Long waits go through delay() so that other tasks - or the
+// background work of the core, eg. WiFi on the ESP8266 - can run in the meantime.
+void SPIFlash::_sleep(uint32_t us) {
+  if (us >= 2000) {
+    delay(us / 1000);
+  }
+  else {
+    _delay_us(us);
+  }
+}
+
+#ifdef ENABLESTATS
+// Adds the time spent in _notBusy() and the number of status register reads it took to the statistics of the current operation.
+//  Takes two arguments -
+//    1. start --> micros() when the wait started
+//    2. polls --> Number of times the status register was read
+void SPIFlash::_countBusyWait(uint32_t start, uint32_t polls) {
+  FlashOpStats &_op = _stats.op[_curOp];
+  _op.busyPolls += polls;
+  _op.busyTime += micros() - start;
+}
+#endif
+
+#ifdef ENABLETRACE
+// Opens a new entry in the trace ring for the transaction that is starting. Called by CHIP_SELECT
+void SPIFlash::_traceSelect() {
+  if (_traceOpen) {
+    _traceDeselect();
+  }
+  FlashTraceEntry &_e = _trace[_traceHead];
+  memset(&_e, 0, sizeof(_e));
+  _e.time = micros();
+  _e.op = _curOp;
+  _e.flags = address4ByteEnabled ? TRACE_4BYTE : 0;
+  _traceBytes = 0;
+  _traceOpen = true;
+}
+
+// Closes the open entry and moves the ring on - the oldest entry is overwritten once the ring is full. Called by CHIP_DESELECT
+void SPIFlash::_traceDeselect() {
+  if (!_traceOpen) {
+    return;
+  }
+  uint32_t _elapsed = micros() - _trace[_traceHead].time;
+  _trace[_traceHead].duration = (_elapsed > 0xFFFF) ? 0xFFFF : _elapsed;
+  _traceHead = (_traceHead + 1) % TRACE_DEPTH;
+  _traceCount++;
+  _traceOpen = false;
+}
+
+// Adds a byte clocked on the bus to the open entry. The first byte is the opcode, followed by the address and
+// dummy bytes if the opcode takes them. Everything after that is counted as data.
+//  Takes two arguments -
+//    1. out --> Byte sent to the chip
+//    2. in --> Byte read back from the chip
+void SPIFlash::_traceByte(uint8_t out, uint8_t in) {
+  if (!_traceOpen) {
+    return;
+  }
+  FlashTraceEntry &_e = _trace[_traceHead];
+  if (_traceBytes == 0) {
+    _e.opcode = out;
+    _traceBytes++;
+    return;
+  }
+  uint8_t _addrBytes = 0, _dummyBytes = 0;
+  switch (_e.opcode) {
+    case JEDEC_READ_FAST:
+    case JEDEC_READ_SFDP:
+    _dummyBytes = 1;
+    // Fall through - these take an address as well
+    case JEDEC_READ_DATA:
+    case JEDEC_PROG_BYTE:
+    case JEDEC_ERASE_SECTOR:
+    case JEDEC_ERASE_BLOCK_32:
+    case JEDEC_ERASE_BLOCK_64:
+    _addrBytes = (_e.flags & TRACE_4BYTE) ? 4 : 3;
+    break;
+  }
+  if (_traceBytes <= _addrBytes) {
+    _e.addr = (_e.addr << 8) | out;
+    _traceBytes++;
+  }
+  else if (_traceBytes <= (uint32_t)_addrBytes + _dummyBytes) {
+    _traceBytes++;
+  }
+  else {
+    _traceData(1, &in);
+  }
+}
+
+// Adds data bytes to the open entry
+//  Takes two arguments -
+//    1. size --> Number of bytes
+//    2. in --> Bytes read back from the chip. NULL if they were not kept
+void SPIFlash::_traceData(uint32_t size, const uint8_t *in) {
+  if (!_traceOpen || !size) {
+    return;
+  }
+  FlashTraceEntry &_e = _trace[_traceHead];
+  if (_e.len == 0 && in) {
+    _e.status = in[0];
+  }
+  _e.len = (_e.len + size > 0xFFFF) ? 0xFFFF : _e.len + size;
 }
+#endif
 
 //Enables writing to chip by setting the JEDEC_SET_WRITE_ENABLE bit
 bool SPIFlash::_writeEnable(bool _troubleshootEnable) {
@@ -389,24 +782,366 @@ bool SPIFlash::_getJedecId() {
   }
 }
 
-bool SPIFlash::_getSFDP() {
+// Reads bytes from the chip's Serial Flash Discoverable Parameters (SFDP)
+//  Takes three arguments -
+//    1. _addr --> Address in the SFDP area
+//    2. data_buffer --> Buffer to read the bytes into
+//    3. size --> Number of bytes to read
+bool SPIFlash::_readSFDP(uint32_t _addr, uint8_t *data_buffer, uint8_t size) {
   if(!_notBusy()) {
   	return false;
   }
-  _currentAddress = 0x00;
+  _currentAddress = _addr;
   _beginSPI(JEDEC_READ_SFDP);
   _transferAddress();
   _nextByte(WRITE, DUMMYBYTE);
-
-  ADDR_BITS_1(_chip.sfdp) = _nextByte(READ);
-  ADDR_BITS_2(_chip.sfdp) = _nextByte(READ);
-  ADDR_BITS_3(_chip.sfdp) = _nextByte(READ);
-  ADDR_BITS_4(_chip.sfdp) = _nextByte(READ);
+  for (uint8_t i = 0; i < size; i++) {
+    data_buffer[i] = _nextByte(READ);
+  }
   CHIP_DESELECT
+  return true;
+}
+
+bool SPIFlash::_getSFDP() {
+  uint8_t _sig[4];
+  if (!_readSFDP(0x00, _sig, 4)) {
+    return false;
+  }
+
+  // The signature is sent least significant byte first
+  _chip.sfdp = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    _chip.sfdp |= (uint32_t)_sig[i] << (8 * i);
+  }
 
   return _chip.sfdp == VOYNICH_SFDP_SIGNATURE;
 }
 
+// Reads the typical program and erase times from the Basic Flash Parameter Table in the SFDP (JESD216A or later)
+// and sets the running estimates and timeouts used by _notBusy() from them. Chips without the table keep the
+// BUSY_MAX_* timeouts and learn the typical times from the first program or erase of each kind.
+bool SPIFlash::_getSFDPTimes() {
+  uint8_t _hdr[16];
+  if (!_readSFDP(0x00, _hdr, 16)) {
+    return false;
+  }
+  _chip.sfdp = (uint32_t)_hdr[3] << 24 | (uint32_t)_hdr[2] << 16 | (uint32_t)_hdr[1] << 8 | _hdr[0];
+  // The first parameter header always describes the Basic Flash Parameter Table. DWORDs 10 and 11 hold the times
+  if (_chip.sfdp != VOYNICH_SFDP_SIGNATURE || _hdr[8] != 0x00 || _hdr[11] < 11) {
+    return false;
+  }
+  uint8_t _b[16];
+  uint32_t _dw[4];                       // DWORDs 8 to 11
+  if (!_readSFDP(((uint32_t)_hdr[14] << 16 | (uint32_t)_hdr[13] << 8 | _hdr[12]) + 28, _b, 16)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    _dw[i] = (uint32_t)_b[4 * i + 3] << 24 | (uint32_t)_b[4 * i + 2] << 16 | (uint32_t)_b[4 * i + 1] << 8 | _b[4 * i];
+  }
+  const uint32_t _eraseUnits[4] = {1000L, 16000L, 128000L, 1000000L};
+  const uint32_t _chipUnits[4] = {16000L, 256000L, 4000000L, 64000000L};
+  uint32_t _typ[BUSY_OPTYPES] = {0, 0, 0, 0, 0};
+
+  // Erase types 1 to 4 - their size (as a power of two) is in DWORD 8 / 9 and their typical time in DWORD 10
+  for (uint8_t t = 0; t < 4; t++) {
+    uint8_t _size = _dw[t / 2] >> (16 * (t % 2));
+    uint8_t _time = (_dw[2] >> (4 + 7 * t)) & 0x7F;
+    uint32_t _us = ((_time & 0x1F) + 1) * _eraseUnits[_time >> 5];
+    switch (_size) {
+      case 12:
+      _typ[BUSY_SE] = _us;
+      break;
+
+      case 15:
+      _typ[BUSY_BE32] = _us;
+      break;
+
+      case 16:
+      _typ[BUSY_BE64] = _us;
+      break;
+    }
+  }
+  // Page program and chip erase times are in DWORD 11
+  _typ[BUSY_PROG] = (((_dw[3] >> 8) & 0x1F) + 1) * ((_dw[3] & (1UL << 13)) ? 64 : 8);
+  _typ[BUSY_CE] = (((_dw[3] >> 24) & 0x1F) + 1) * _chipUnits[(_dw[3] >> 29) & 0x03];
+
+  // The maximum times are the typical times multiplied by 2 * (count + 1)
+  uint8_t _eraseMult = 2 * ((_dw[2] & 0x0F) + 1);
+  uint8_t _progMult = 2 * ((_dw[3] & 0x0F) + 1);
+  for (uint8_t i = 0; i < BUSY_OPTYPES; i++) {
+    if (_typ[i]) {
+      uint8_t _mult = (i == BUSY_PROG) ? _progMult : _eraseMult;
+      _busyTyp[i] = _typ[i];
+      _busyMax[i] = (_typ[i] > 0xFFFFFFFF / _mult) ? 0xFFFFFFFF : _typ[i] * _mult;
+    }
+  }
+  return true;
+}
+
+#ifdef SPI_HAS_TRANSACTION
+// Returns byte i of the 4 KB pattern used by calibrate(). The first page alternates bits, the second has runs of ones
+// and zeros and the rest is pseudo random, so that bits sampled too early or too late show up.
+uint8_t SPIFlash::_calPattern(uint16_t i) {
+  switch ((i >> 8) & 0x03) {
+    case 0:
+    return (i & 1) ? 0xAA : 0x55;
+
+    case 1:
+    return (i & 2) ? 0xFF : 0x00;
+
+    default:
+    return (uint8_t)(i * 73 + (i >> 3)) ^ 0x5A;
+  }
+}
+
+// Erases the scratch sector used by calibrate() and programs the pattern into it at the command clock in use
+bool SPIFlash::_calWrite(uint32_t _addr) {
+  if (!eraseSector(_addr)) {
+    return false;
+  }
+  for (uint16_t _page = 0; _page < KB(4); _page += SPI_PAGESIZE) {
+    if (!_prep(JEDEC_PROG_BYTE, _addr + _page, SPI_PAGESIZE)) {
+      return false;
+    }
+    _beginSPI(JEDEC_PROG_BYTE);
+    for (uint16_t i = 0; i < SPI_PAGESIZE; i++) {
+      _nextByte(WRITE, _calPattern(_page + i));
+    }
+    _endSPI();
+  }
+  return _notBusy();
+}
+
+// Reads the pattern back from the scratch sector used by calibrate() at a trial clock. Only the command under test runs
+// at the trial clock - the status reads before it use the clocks in use. A normal read is preceded by a read of the
+// JEDEC ID, so that the commands sharing its clock profile are tried as well.
+//  Takes three arguments -
+//    1. _addr --> Start of the scratch sector
+//    2. opcode --> JEDEC_READ_DATA or JEDEC_READ_FAST
+//    3. clock --> Trial clock - in Hz
+bool SPIFlash::_calCheck(uint32_t _addr, uint8_t opcode, uint32_t clock) {
+  if (!_prep(JEDEC_READ_DATA, _addr, KB(4))) {
+    return false;
+  }
+  if (SPIBusState) {
+    SPI.endTransaction();
+    SPIBusState = false;
+  }
+  SPISettings &_profile = (opcode == JEDEC_READ_FAST) ? _fastSettings : _settings;
+  SPISettings _inUse = _profile;
+  _profile = SPISettings(clock, MSBFIRST, SPI_MODE0);
+
+  bool _ok = true;
+  if (opcode == JEDEC_READ_DATA) {
+    _beginSPI(JEDEC_READ_JEDECID);
+    _ok = (_nextByte(READ) == _chip.manufacturerID);
+    _ok = (_nextByte(READ) == _chip.memoryTypeID) && _ok;
+    _ok = (_nextByte(READ) == _chip.capacityID) && _ok;
+    CHIP_DESELECT
+  }
+  _beginSPI(opcode);
+  for (uint16_t i = 0; _ok && i < KB(4); i++) {
+    _ok = (_nextByte(READ) == _calPattern(i));
+  }
+  _endSPI();
+  _profile = _inUse;
+  return _ok;
+}
+#endif
+
+// Starts an asynchronous erase or write and issues its first command. opcode is JEDEC_PROG_BYTE for writes and
+// ERASEFUNC for erases, which are passed as a sector aligned address and size. Only one job can run at a time.
+// With a time budget set, it carries on with the job until the budget runs out - see setTimeBudget().
+bool SPIFlash::_startJob(FlashJob &job, uint8_t opcode, uint32_t _addr, uint32_t size, uint8_t *buffer, bool errorCheck, FlashJobCallback callback) {
+  uint32_t _start = micros();
+  job.opcode = opcode;
+  job.addr = _addr;
+  job.remaining = size;
+  job.step = 0;
+  job.buffer = buffer;
+  job.errorCheck = errorCheck;
+  job.callback = callback;
+  job.error = VOYNICH_STATUS_SUCCESS;
+  if (_job) {
+    job.state = JOB_ERROR;
+    job.error = JOBRUNNING;
+    _troubleshoot(JOBRUNNING);
+    return false;
+  }
+  job.state = JOB_BUSY;
+  _job = &job;
+  if (!size) {
+    _endJob(JOB_DONE);
+    return true;
+  }
+  if (!_issueJobCommand()) {
+    _endJob(JOB_ERROR);
+    return false;
+  }
+  if (_timeBudget) {
+    return _runJob(_start, _timeBudget, true) != JOB_ERROR;
+  }
+  return true;
+}
+
+// Issues the next command of the job in progress without waiting for it to complete. Erases use the largest of the
+// chip, 64 KB / 32 KB block and 4 KB sector erases that starts at the address and fits in what is left.
+bool SPIFlash::_issueJobCommand() {
+  FlashJob &_j = *_job;
+  if (_j.opcode == JEDEC_PROG_BYTE) {
+    _j.step = SPI_PAGESIZE - (_j.addr % SPI_PAGESIZE);
+    if (_j.step > _j.remaining) {
+      _j.step = _j.remaining;
+    }
+    if (!_pageProgram(_j.addr, _j.buffer, _j.step)) {
+      return false;
+    }
+    _j.buffer += _j.step;
+  }
+  else {
+    if (!_j.addr && _j.remaining >= _chip.capacity) {
+      _j.opcode = JEDEC_ERASE_CHIP;
+      _j.step = _j.remaining;
+    }
+    else if (!(_j.addr % KB(64)) && _j.remaining >= KB(64)) {
+      _j.opcode = JEDEC_ERASE_BLOCK_64;
+      _j.step = KB(64);
+    }
+    else if (!(_j.addr % KB(32)) && _j.remaining >= KB(32)) {
+      _j.opcode = JEDEC_ERASE_BLOCK_32;
+      _j.step = KB(32);
+    }
+    else {
+      _j.opcode = JEDEC_ERASE_SECTOR;
+      _j.step = KB(4);
+    }
+    if (_j.opcode == JEDEC_ERASE_CHIP) {
+      if (_isChipPoweredDown() || !_notBusy() || !_writeEnable()) {
+        return false;
+      }
+    }
+    else if (!_prep(ERASEFUNC, _j.addr, _j.step)) {
+      return false;
+    }
+    _beginSPI(_j.opcode);   //The address is transferred as a part of this function
+    _endSPI();
+  }
+  _j.addr += _j.step;
+  _j.remaining -= _j.step;
+  return true;
+}
+
+// Finishes the job in progress and calls its callback. The library is ready for the next job by the time the callback
+// runs, so it may start one. Returns the final state of the job.
+uint8_t SPIFlash::_endJob(uint8_t state) {
+  FlashJob &_j = *_job;
+  _job = NULL;
+  _j.state = state;
+  if (state == JOB_ERROR && _j.error == VOYNICH_STATUS_SUCCESS) {
+    _j.error = errorcode;
+  }
+  if (_j.callback) {
+    _j.callback(_j);
+  }
+  return state;
+}
+
+// Takes one step of the job in progress - checks whether the chip has finished the command last issued, verifies the page
+// just programmed and issues the next command. Does not wait for the chip. Returns the state of the job, as poll() does.
+uint8_t SPIFlash::_advanceJob() {
+  if (!_job) {
+    return JOB_IDLE;
+  }
+  // isBusy() drops _busyOp once the chip is found idle, so the time the job spent waiting for this call is not
+  // taken for the time the command took
+  if (_busyOp != BUSY_NONE) {
+    uint32_t _elapsed = micros() - _busyStart;
+    if (_elapsed < _busyTyp[_busyOp] - _busyTyp[_busyOp] / BUSY_EARLY || (isBusy() && _elapsed < _busyMax[_busyOp])) {
+      return JOB_BUSY;
+    }
+  }
+  else if (isBusy()) {
+    return JOB_BUSY;
+  }
+  FLASH_OP((_job->opcode == JEDEC_PROG_BYTE) ? STATS_WRITE : STATS_ERASE, 0)
+  // Records the time taken by the command or raises VOYNICH_STATUS_CHIPBUSY if it has timed out
+  if (!_notBusy()) {
+    return _endJob(JOB_ERROR);
+  }
+  if (_job->opcode == JEDEC_PROG_BYTE && _job->errorCheck) {
+    uint32_t _addr = _job->addr - _job->step;
+    uint8_t *_data = _job->buffer - _job->step;
+    if (!_prep(JEDEC_READ_DATA, _addr, _job->step)) {
+      return _endJob(JOB_ERROR);
+    }
+    _beginSPI(JEDEC_READ_DATA);
+    for (uint16_t i = 0; i < _job->step; i++) {
+      if (_nextByte(READ) != _data[i]) {
+        _troubleshoot(ERRORCHKFAIL);
+        _endSPI();
+        return _endJob(JOB_ERROR);
+      }
+    }
+    _endSPI();
+  }
+  if (!_job->remaining) {
+    return _endJob(JOB_DONE);
+  }
+  if (!_issueJobCommand()) {
+    return _endJob(JOB_ERROR);
+  }
+  return JOB_BUSY;
+}
+
+// Steps the job in progress until it completes or the time budget runs out. Between steps it sleeps until the command
+// in progress is expected to be nearly complete and then polls the status register at growing intervals, as _notBusy()
+// does. A step is only taken if the longest step seen so far (_jobCost) still fits in what is left of the budget - until
+// one has been timed, the transfers of a page program, its blank check and its read back at the command clock are
+// allowed for. The first step of a call from poll() is always taken.
+//  Takes three arguments -
+//    1. start --> Time the call started at - from micros()
+//    2. budget --> Time the call may take - in uS
+//    3. stepped --> true if the call has already issued a command - as the asynchronous erase / write functions do
+uint8_t SPIFlash::_runJob(uint32_t start, uint32_t budget, bool stepped) {
+  uint32_t _interval = BUSY_POLLMIN;
+  uint32_t _seed = (3UL * (SPI_PAGESIZE + 5) * 8000UL) / (_clock / 1000 + 1);
+  for (;;) {
+    uint32_t _cost = (_jobCost > _seed) ? _jobCost : _seed;
+    uint32_t _stepStart = micros();
+    if (stepped && _stepStart - start + _cost > budget) {
+      return JOB_BUSY;
+    }
+    uint8_t _state = _advanceJob();
+    stepped = true;
+    uint32_t _now = micros();
+    // A step that ends the job includes its callback, which is not the library's to budget for
+    if (_state == JOB_BUSY && _now - _stepStart > _jobCost) {
+      _jobCost = _now - _stepStart;
+      _cost = (_jobCost > _seed) ? _jobCost : _seed;
+    }
+    uint32_t _spent = _now - start;
+    if (_state != JOB_BUSY || _spent + _cost >= budget) {
+      return _state;
+    }
+    uint32_t _wait = _interval;
+    if (_busyOp != BUSY_NONE) {
+      uint32_t _elapsed = _now - _busyStart;
+      uint32_t _expected = _busyTyp[_busyOp] - _busyTyp[_busyOp] / BUSY_EARLY;
+      if (_elapsed < _expected) {
+        _wait = _expected - _elapsed;
+        _interval = BUSY_POLLMIN;
+      }
+      else {
+        _interval <<= 1;
+      }
+    }
+    if (_wait > budget - _spent - _cost) {
+      return JOB_BUSY;
+    }
+    _sleep(_wait);
+  }
+}
+
 bool SPIFlash::_disableGlobalBlockProtect() {
   if (_chip.memoryTypeID == MICROCHIP_SST25) {
     _readStat1();
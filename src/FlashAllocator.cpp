@@ -0,0 +1,226 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashAllocator.h"
+
+// Constructor
+//  Takes eight arguments -
+//    1. flash --> The SPIFlash object to allocate from. begin() must have been called on it first
+//    2. startAddr --> Address of the region to hand out. Rounded up to a whole unit
+//    3. size --> Size of the region - in number of bytes
+//    4. unitSize --> Size of the smallest extent - SPI_PAGESIZE, KB(4) or any multiple of them
+//    5. metaAddr --> Address of the region the allocations are stored in. Must not overlap the region handed out
+//    6. metaSize --> Size of the metadata region - at least two sectors
+//    7. bitmap --> Array of one bit per unit in the region - ALLOC_BITMAPSIZE(size, unitSize) bytes. Must stay in scope
+//    8. bitmapSize --> Size of bitmap - in number of bytes. begin() fails if the region has more units than it holds
+FlashAllocator::FlashAllocator(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint32_t unitSize, uint32_t metaAddr, uint32_t metaSize,
+                               uint8_t *bitmap, uint16_t bitmapSize)
+  : _meta(flash, metaAddr, metaSize) {
+  _flash = &flash;
+  _unitSize = unitSize ? unitSize : SPI_PAGESIZE;
+  _startAddr = (startAddr + _unitSize - 1) - ((startAddr + _unitSize - 1) % _unitSize);
+  uint32_t _units = (startAddr + size > _startAddr) ? (startAddr + size - _startAddr) / _unitSize : 0;
+  _hdr.magic = ALLOC_MAGIC;
+  _hdr.startAddr = _startAddr;
+  _hdr.unitSize = _unitSize;
+  // A region that does not fit in the bitmap is left with no units, so that begin() fails
+  _hdr.numUnits = (bitmap && _units <= 0xFFFF && _units <= (uint32_t)bitmapSize * 8) ? _units : 0;
+  _hdr.cursor = 0;
+  _bitmap = bitmap;
+}
+
+// Loads the allocations stored in the metadata region. If there are none - or they were made for a different
+// region - every unit starts out free. Must be called before the first allocation. Fails if the region holds no
+// whole unit or more units than the bitmap passed to the constructor.
+bool FlashAllocator::begin() {
+  if (!_hdr.numUnits) {
+    return false;
+  }
+  memset(_bitmap, 0, (_hdr.numUnits + 7) / 8);
+  _hdr.cursor = 0;
+  if (!_meta.begin()) {
+    return false;
+  }
+  allocHeader _stored;
+  uint16_t _bytes = (_hdr.numUnits + 7) / 8;
+  if (_meta.length() == sizeof(_stored) + _bytes && _meta.read(0, &_stored, sizeof(_stored)) &&
+      _stored.magic == ALLOC_MAGIC && _stored.startAddr == _hdr.startAddr && _stored.unitSize == _hdr.unitSize &&
+      _stored.numUnits == _hdr.numUnits) {
+    _hdr.cursor = _stored.cursor;
+    return _meta.read(sizeof(_stored), _bitmap, _bytes);
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of units needed to hold size bytes
+uint16_t FlashAllocator::_units(uint32_t size) {
+  uint32_t _n = (size + _unitSize - 1) / _unitSize;
+  return (_n > _hdr.numUnits) ? 0 : _n;
+}
+
+bool FlashAllocator::_isFree(uint16_t first, uint16_t units) {
+  for (uint16_t i = first; i < first + units; i++) {
+    if (_bitmap[i / 8] & (1 << (i % 8))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FlashAllocator::_mark(uint16_t first, uint16_t units, bool used) {
+  for (uint16_t i = first; i < first + units; i++) {
+    if (used) {
+      _bitmap[i / 8] |= (1 << (i % 8));
+    }
+    else {
+      _bitmap[i / 8] &= ~(1 << (i % 8));
+    }
+  }
+}
+
+// Stores the header and the bitmap as a single commit
+bool FlashAllocator::_store() {
+  FlashIOVec _parts[2];
+  _parts[0].addr = 0;
+  _parts[0].buffer = (uint8_t*)&_hdr;
+  _parts[0].len = sizeof(_hdr);
+  _parts[1].addr = sizeof(_hdr);
+  _parts[1].buffer = _bitmap;
+  _parts[1].len = (_hdr.numUnits + 7) / 8;
+  return _meta.commit(_parts, 2);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Allocation functions                        //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Allocates an extent of whole units.
+//  Takes three arguments -
+//    1. size --> Size of the extent - in number of bytes. Rounded up to whole units
+//    2. addr --> Variable to return the address of the extent into
+//    3. erase --> Turned on by default. Erases the extent if it is made of whole sectors and is not blank already
+bool FlashAllocator::allocate(uint32_t size, uint32_t &addr, bool erase) {
+  uint16_t _n = _units(size);
+  if (!_n) {
+    return false;
+  }
+  uint16_t _first = _hdr.cursor;
+  if (_first + _n > _hdr.numUnits || !_isFree(_first, _n)) {
+    // First fit - a run of free units that is long enough
+    uint16_t _run = 0;
+    for (_first = 0; _first + _run < _hdr.numUnits && _run < _n;) {
+      if (_bitmap[(_first + _run) / 8] & (1 << ((_first + _run) % 8))) {
+        _first += _run + 1;
+        _run = 0;
+      }
+      else {
+        _run++;
+      }
+    }
+    if (_run < _n) {
+      return false;
+    }
+  }
+
+  // Erase before the extent is recorded as used - if the erase fails the units are still free, and erasing
+  // free units does no harm
+  uint32_t _addr = _startAddr + (uint32_t)_first * _unitSize;
+  if (erase && !(_unitSize % KB(4))) {
+    uint8_t _buf[32];
+    for (uint32_t _off = 0; _off < (uint32_t)_n * _unitSize; _off += KB(4)) {
+      // Skip the erase if the sector is blank already
+      for (uint32_t i = 0; i < KB(4); i += sizeof(_buf)) {
+        if (!_flash->readByteArray(_addr + _off + i, _buf, sizeof(_buf))) {
+          return false;
+        }
+        uint8_t j = 0;
+        while (j < sizeof(_buf) && _buf[j] == 0xFF) {
+          j++;
+        }
+        if (j < sizeof(_buf)) {
+          if (!_flash->eraseSector(_addr + _off)) {
+            return false;
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  uint16_t _cursor = _hdr.cursor;
+  _mark(_first, _n, true);
+  _hdr.cursor = _first + _n;
+  if (!_store()) {
+    _mark(_first, _n, false);
+    _hdr.cursor = _cursor;
+    return false;
+  }
+  addr = _addr;
+  return true;
+}
+
+// Returns an extent to the free space. It merges with any free units around it.
+//  Takes two arguments -
+//    1. addr --> Address returned by allocate()
+//    2. size --> Size the extent was allocated with - in number of bytes
+bool FlashAllocator::free(uint32_t addr, uint32_t size) {
+  uint16_t _n = _units(size);
+  if (!_n || addr < _startAddr || (addr - _startAddr) % _unitSize) {
+    return false;
+  }
+  uint32_t _first = (addr - _startAddr) / _unitSize;
+  if (_first + _n > _hdr.numUnits) {
+    return false;
+  }
+  for (uint16_t i = _first; i < _first + _n; i++) {
+    if (!(_bitmap[i / 8] & (1 << (i % 8)))) {
+      return false;     // Not allocated
+    }
+  }
+  _mark(_first, _n, false);
+  if (!_store()) {
+    _mark(_first, _n, true);
+    return false;
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Information functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of bytes that are free - not necessarily in one piece
+uint32_t FlashAllocator::available() {
+  uint32_t _free = 0;
+  for (uint16_t i = 0; i < _hdr.numUnits; i++) {
+    if (!(_bitmap[i / 8] & (1 << (i % 8)))) {
+      _free++;
+    }
+  }
+  return _free * _unitSize;
+}
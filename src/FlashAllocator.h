@@ -0,0 +1,76 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHALLOCATOR_H
+#define FLASHALLOCATOR_H
+
+#include "SPIFlash.h"
+#include "FlashCommit.h"
+
+#define ALLOC_MAGIC     0xA110C8ED
+#define ALLOC_BITMAPSIZE(size, unitSize)  (((size) / (unitSize) + 7) / 8)   // Bytes of bitmap a region needs
+
+// Hands out extents of a region of the flash memory to the parts of a sketch that share the chip, and takes them
+// back when they are no longer needed. The region is split into units - pages or sectors - and a bitmap in RAM
+// passed to the constructor keeps track of the units in use, so freed extents merge with their free neighbours without any bookkeeping.
+// Allocations are first tried right after the previous one, which costs next to nothing when extents are handed
+// out one after the other, as they are for logs. Otherwise the first big enough run of free units is used.
+// Every change is stored atomically in a separate metadata region of at least two sectors (see FlashCommit),
+// so the allocations survive a reset. Extents of whole sectors are erased when they are handed out - extents
+// of pages are not, since erasing them would erase their neighbours as well.
+class FlashAllocator {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashAllocator(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint32_t unitSize, uint32_t metaAddr, uint32_t metaSize,
+                 uint8_t *bitmap, uint16_t bitmapSize);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin();
+  //--------------------------------- Allocation functions ------------------------------//
+  bool     allocate(uint32_t size, uint32_t &addr, bool erase = true);
+  bool     free(uint32_t addr, uint32_t size);
+  //-------------------------------- Information functions ------------------------------//
+  uint32_t available();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _isFree(uint16_t first, uint16_t units);
+  void     _mark(uint16_t first, uint16_t units, bool used);
+  bool     _store();
+  uint16_t _units(uint32_t size);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  FlashCommit _meta;
+  uint32_t    _startAddr, _unitSize;
+  struct      allocHeader {
+                uint32_t magic;
+                uint32_t startAddr;
+                uint32_t unitSize;
+                uint16_t numUnits;
+                uint16_t cursor;
+              };
+              allocHeader _hdr;           // _hdr.cursor is the unit after the previous allocation
+  uint8_t     *_bitmap;                   // One bit per unit - set if the unit is in use
+};
+
+#endif // FLASHALLOCATOR_H
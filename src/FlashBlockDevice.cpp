@@ -0,0 +1,258 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashBlockDevice.h"
+
+#define BD_SYNCTIMEOUT  10        // Longest a page program may take - in milliseconds
+
+// Constructor
+//  Takes seven arguments -
+//    1. flash --> The SPIFlash object holding the filesystem. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the filesystem. Only whole blocks inside the region are used
+//    3. size --> Size of the region - in number of bytes
+//    4. readCache --> Optional. Buffer for the read cache. Reads smaller than the cache are served from it.
+//       Without one every read goes to the chip
+//    5. readCacheSize --> Size of readCache - in number of bytes. At most BD_BLOCKSIZE of it is used
+//    6. progCache --> Optional. Buffer for the program cache. Best a multiple of SPI_PAGESIZE, so that each
+//       program fills whole pages. Without one every program goes to the chip as it is issued
+//    7. progCacheSize --> Size of progCache - in number of bytes. At most BD_BLOCKSIZE of it is used
+FlashBlockDevice::FlashBlockDevice(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint8_t *readCache, uint16_t readCacheSize,
+                                   uint8_t *progCache, uint16_t progCacheSize) {
+  _flash = &flash;
+  _startAddr = (startAddr + BD_BLOCKSIZE - 1) - ((startAddr + BD_BLOCKSIZE - 1) % BD_BLOCKSIZE);
+  uint32_t _endAddr = (startAddr + size) - ((startAddr + size) % BD_BLOCKSIZE);
+  _numBlocks = (_endAddr > _startAddr) ? (_endAddr - _startAddr) / BD_BLOCKSIZE : 0;
+  _rCache = readCache;
+  _rSize = readCache ? ((readCacheSize > BD_BLOCKSIZE) ? BD_BLOCKSIZE : readCacheSize) : 0;
+  _rAddr = 0;
+  _rValid = false;
+  _pCache = progCache;
+  _pSize = progCache ? ((progCacheSize > BD_BLOCKSIZE) ? BD_BLOCKSIZE : progCacheSize) : 0;
+  _pAddr = 0;
+  _pStart = _pEnd = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+bool FlashBlockDevice::_check(uint32_t block, uint32_t off, uint32_t size) {
+  return block < _numBlocks && off <= BD_BLOCKSIZE && size <= BD_BLOCKSIZE - off;
+}
+
+// Programs data to the chip. The filesystem only programs erased blocks, so the check for previously written
+// data is skipped.
+bool FlashBlockDevice::_write(uint32_t _addr, const uint8_t *data, uint32_t size) {
+  bool _blankCheck = _flash->getBlankCheck();
+  _flash->setBlankCheck(false);
+  bool _ok = _flash->writeByteArray(_addr, (uint8_t*)data, size, false);
+  _flash->setBlankCheck(_blankCheck);
+  return _ok;
+}
+
+// Programs the bytes waiting in the program cache
+bool FlashBlockDevice::_program() {
+  if (_pEnd > _pStart && !_write(_pAddr + _pStart, &_pCache[_pStart], _pEnd - _pStart)) {
+    return false;
+  }
+  _pStart = _pEnd = 0;
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                          Block functions                           //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Reads from a block. Bytes still waiting in the program cache are read from there.
+//  Takes four arguments -
+//    1. block --> Block to read from
+//    2. off --> Offset in the block
+//    3. buffer --> Buffer to read the data into
+//    4. size --> Number of bytes to read
+int FlashBlockDevice::read(uint32_t block, uint32_t off, void *buffer, uint32_t size) {
+  if (!_check(block, off, size)) {
+    return BD_ERR_INVAL;
+  }
+  uint32_t _addr = _startAddr + block * BD_BLOCKSIZE + off;
+  if (size < _rSize) {
+    if (!_rValid || _addr < _rAddr || _addr + size > _rAddr + _rSize) {
+      _rAddr = _addr - (_addr % _rSize);
+      if (_addr + size > _rAddr + _rSize) {
+        _rAddr = _addr;
+      }
+      if (_rAddr + _rSize > _startAddr + _numBlocks * BD_BLOCKSIZE) {
+        _rAddr = _startAddr + _numBlocks * BD_BLOCKSIZE - _rSize;
+      }
+      _rValid = _flash->readByteArray(_rAddr, _rCache, _rSize);
+      if (!_rValid) {
+        return BD_ERR_IO;
+      }
+    }
+    memcpy(buffer, &_rCache[_addr - _rAddr], size);
+  }
+  else if (!_flash->readByteArray(_addr, (uint8_t*)buffer, size)) {
+    return BD_ERR_IO;
+  }
+
+  // Overlay anything that has not been programmed yet
+  uint32_t _from = _pAddr + _pStart, _to = _pAddr + _pEnd;
+  if (_pEnd > _pStart && _from < _addr + size && _addr < _to) {
+    if (_from < _addr) {
+      _from = _addr;
+    }
+    if (_to > _addr + size) {
+      _to = _addr + size;
+    }
+    memcpy((uint8_t*)buffer + (_from - _addr), &_pCache[_from - _pAddr], _to - _from);
+  }
+  return BD_OK;
+}
+
+// Programs data to an erased part of a block. With a program cache, data is gathered in it and programmed once
+// the cache is full, when the next program goes somewhere else, or on sync().
+//  Takes four arguments -
+//    1. block --> Block to program
+//    2. off --> Offset in the block
+//    3. buffer --> Data to be programmed
+//    4. size --> Size of the data - in number of bytes
+int FlashBlockDevice::prog(uint32_t block, uint32_t off, const void *buffer, uint32_t size) {
+  if (!_check(block, off, size)) {
+    return BD_ERR_INVAL;
+  }
+  uint32_t _addr = _startAddr + block * BD_BLOCKSIZE + off;
+  const uint8_t *_src = (const uint8_t*)buffer;
+  if (_rValid && _addr < _rAddr + _rSize && _rAddr < _addr + size) {
+    _rValid = false;
+  }
+  if (!_pSize) {
+    return _write(_addr, _src, size) ? BD_OK : BD_ERR_IO;
+  }
+  while (size) {
+    uint32_t _page = _addr - (_addr % _pSize);
+    uint16_t _off = _addr % _pSize;
+    if (_pEnd > _pStart && (_page != _pAddr || _off != _pEnd) && !_program()) {
+      return BD_ERR_IO;
+    }
+    if (_pEnd == _pStart) {
+      _pAddr = _page;
+      _pStart = _pEnd = _off;
+    }
+    uint16_t _n = _pSize - _off;
+    if (_n > size) {
+      _n = size;
+    }
+    memcpy(&_pCache[_off], _src, _n);
+    _pEnd += _n;
+    if (_pEnd == _pSize && !_program()) {
+      return BD_ERR_IO;
+    }
+    _addr += _n;
+    _src += _n;
+    size -= _n;
+  }
+  return BD_OK;
+}
+
+// Erases a block
+//  Takes one argument -
+//    1. block --> Block to erase
+int FlashBlockDevice::erase(uint32_t block) {
+  if (!_check(block, 0, 0)) {
+    return BD_ERR_INVAL;
+  }
+  uint32_t _addr = _startAddr + block * BD_BLOCKSIZE;
+  if (_pEnd > _pStart) {
+    if (_pAddr + _pStart >= _addr && _pAddr + _pEnd <= _addr + BD_BLOCKSIZE) {
+      _pStart = _pEnd = 0;      // Would be erased straight away
+    }
+    else if (!_program()) {
+      return BD_ERR_IO;
+    }
+  }
+  if (_rValid && _rAddr < _addr + BD_BLOCKSIZE && _addr < _rAddr + _rSize) {
+    _rValid = false;
+  }
+  return _flash->eraseSector(_addr) ? BD_OK : BD_ERR_IO;
+}
+
+// Programs anything left in the program cache and waits for the chip to finish
+int FlashBlockDevice::sync() {
+  if (!_program()) {
+    return BD_ERR_IO;
+  }
+  uint32_t _start = millis();
+  while (_flash->isBusy()) {
+    if (millis() - _start > BD_SYNCTIMEOUT) {
+      return BD_ERR_IO;
+    }
+  }
+  return BD_OK;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                          Sector functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Reads whole sectors - one sector is one block - as the disk_read() of FatFs does.
+//  Takes three arguments -
+//    1. buffer --> Buffer to read the sectors into. Must hold count x 4096 bytes
+//    2. sector --> First sector to read
+//    3. count --> Number of sectors to read
+int FlashBlockDevice::readSectors(uint8_t *buffer, uint32_t sector, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    int _err = read(sector + i, 0, buffer + i * BD_BLOCKSIZE, BD_BLOCKSIZE);
+    if (_err) {
+      return _err;
+    }
+  }
+  return BD_OK;
+}
+
+// Writes whole sectors - one sector is one block - as the disk_write() of FatFs does. Each sector is erased
+// and programmed a page at a time.
+//  Takes three arguments -
+//    1. buffer --> Data to be written. Must hold count x 4096 bytes
+//    2. sector --> First sector to write
+//    3. count --> Number of sectors to write
+int FlashBlockDevice::writeSectors(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    int _err = erase(sector + i);
+    if (!_err) {
+      _err = prog(sector + i, 0, buffer + i * BD_BLOCKSIZE, BD_BLOCKSIZE);
+    }
+    if (_err) {
+      return _err;
+    }
+  }
+  return sync();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Information functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of blocks - or FatFs sectors - in the region
+uint32_t FlashBlockDevice::blockCount() {
+  return _numBlocks;
+}
@@ -0,0 +1,144 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHBLOCKDEVICE_H
+#define FLASHBLOCKDEVICE_H
+
+#include "SPIFlash.h"
+
+#define BD_BLOCKSIZE    KB(4)
+#ifndef BD_PROGSIZE
+#define BD_PROGSIZE     16                // Smallest program the filesystem is told it may issue
+#endif
+#ifndef BD_LOOKAHEAD
+#define BD_LOOKAHEAD    16                // Size of the littlefs lookahead buffer - in number of bytes
+#endif
+
+// Error codes - the same as littlefs uses
+#define BD_OK           0
+#define BD_ERR_IO       -5
+#define BD_ERR_INVAL    -22
+
+// Presents a region of the flash memory as a block device for a filesystem: 4KB blocks that are read, programmed
+// and erased through read(), prog(), erase() and sync(), as littlefs expects them. The filesystem takes care of
+// erasing blocks before it programs them, so the check for previously written data is skipped. Given a program
+// cache, small programs are gathered in it and programmed a cache at a time; given a read cache, small reads are
+// served from it. Both are buffers passed to the constructor. With lfs.h included before this file, lfsConfig()
+// fills in a struct lfs_config; readSectors() and writeSectors() do the same for the disk_read() and disk_write()
+// of FatFs set up with 4096 byte sectors.
+class FlashBlockDevice {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashBlockDevice(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint8_t *readCache = NULL, uint16_t readCacheSize = 0,
+                   uint8_t *progCache = NULL, uint16_t progCacheSize = 0);
+  //---------------------------------- Block functions ----------------------------------//
+  int      read(uint32_t block, uint32_t off, void *buffer, uint32_t size);
+  int      prog(uint32_t block, uint32_t off, const void *buffer, uint32_t size);
+  int      erase(uint32_t block);
+  int      sync();
+  //---------------------------------- Sector functions ---------------------------------//
+  int      readSectors(uint8_t *buffer, uint32_t sector, uint32_t count);
+  int      writeSectors(const uint8_t *buffer, uint32_t sector, uint32_t count);
+  //-------------------------------- Information functions ------------------------------//
+  uint32_t blockCount();
+#ifdef LFS_H
+  //---------------------------------- littlefs glue ------------------------------------//
+  void     lfsConfig(struct lfs_config &cfg, uint8_t *readBuffer = NULL, uint8_t *progBuffer = NULL, uint8_t *lookaheadBuffer = NULL);
+#endif
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _program();
+  bool     _write(uint32_t _addr, const uint8_t *data, uint32_t size);
+  bool     _check(uint32_t block, uint32_t off, uint32_t size);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  uint32_t    _startAddr, _numBlocks;
+  // Read cache - holds the _rSize bytes from _rAddr. Not used if _rSize is 0
+  uint8_t     *_rCache;
+  uint16_t    _rSize;
+  uint32_t    _rAddr;
+  bool        _rValid;
+  // Program cache - the bytes from _pStart to _pEnd of the _pSize byte window at _pAddr are waiting to be programmed.
+  // Not used if _pSize is 0
+  uint8_t     *_pCache;
+  uint16_t    _pSize;
+  uint32_t    _pAddr;
+  uint16_t    _pStart, _pEnd;
+#ifdef LFS_H
+  static int _lfsRead(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+  static int _lfsProg(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+  static int _lfsErase(const struct lfs_config *c, lfs_block_t block);
+  static int _lfsSync(const struct lfs_config *c);
+#endif
+};
+
+#ifdef LFS_H
+//----------------------------------- littlefs glue -------------------------------------//
+// Kept in the header so that it is only compiled into sketches that include lfs.h first.
+
+inline int FlashBlockDevice::_lfsRead(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
+  return ((FlashBlockDevice*)c->context)->read(block, off, buffer, size);
+}
+
+inline int FlashBlockDevice::_lfsProg(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
+  return ((FlashBlockDevice*)c->context)->prog(block, off, buffer, size);
+}
+
+inline int FlashBlockDevice::_lfsErase(const struct lfs_config *c, lfs_block_t block) {
+  return ((FlashBlockDevice*)c->context)->erase(block);
+}
+
+inline int FlashBlockDevice::_lfsSync(const struct lfs_config *c) {
+  return ((FlashBlockDevice*)c->context)->sync();
+}
+
+// Fills in a littlefs configuration for the block device. littlefs keeps its own read and program caches of
+// cache_size bytes - a page by default - on top of the ones in the block device.
+//  Takes four arguments -
+//    1. cfg --> Configuration to fill in. Other fields - block_cycles, for example - may be changed afterwards
+//    2. readBuffer --> Optional. SPI_PAGESIZE bytes for the littlefs read cache. Allocated by littlefs if NULL
+//    3. progBuffer --> Optional. SPI_PAGESIZE bytes for the littlefs program cache. Allocated by littlefs if NULL
+//    4. lookaheadBuffer --> Optional. BD_LOOKAHEAD bytes for the littlefs lookahead buffer. Allocated by littlefs if NULL
+inline void FlashBlockDevice::lfsConfig(struct lfs_config &cfg, uint8_t *readBuffer, uint8_t *progBuffer, uint8_t *lookaheadBuffer) {
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.context = this;
+  cfg.read = _lfsRead;
+  cfg.prog = _lfsProg;
+  cfg.erase = _lfsErase;
+  cfg.sync = _lfsSync;
+  cfg.read_size = 1;
+  cfg.prog_size = BD_PROGSIZE;
+  cfg.block_size = BD_BLOCKSIZE;
+  cfg.block_count = _numBlocks;
+  cfg.block_cycles = 500;
+  cfg.cache_size = SPI_PAGESIZE;
+  cfg.lookahead_size = BD_LOOKAHEAD;
+  cfg.read_buffer = readBuffer;
+  cfg.prog_buffer = progBuffer;
+  cfg.lookahead_buffer = lookaheadBuffer;
+}
+#endif
+
+#endif // FLASHBLOCKDEVICE_H
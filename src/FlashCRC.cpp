@@ -0,0 +1,52 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashCRC.h"
+#if defined (ARDUINO_ARCH_AVR)
+  #include <avr/pgmspace.h>
+#else
+  #define PROGMEM
+  #define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#endif
+
+static const uint32_t _crcTable[16] PROGMEM = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Computes the CRC-32 of a buffer.
+//  Takes three arguments -
+//    1. data --> Buffer to be checksummed
+//    2. len --> Size of the buffer - in number of bytes
+//    3. crc --> Optional. CRC of the data that came before the buffer
+uint32_t flashCRC32(const void *data, size_t len, uint32_t crc) {
+  const uint8_t *_p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *_p++;
+    crc = pgm_read_dword(&_crcTable[crc & 0x0F]) ^ (crc >> 4);
+    crc = pgm_read_dword(&_crcTable[crc & 0x0F]) ^ (crc >> 4);
+  }
+  return ~crc;
+}
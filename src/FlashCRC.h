@@ -0,0 +1,36 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHCRC_H
+#define FLASHCRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (as used by zlib and Ethernet). Uses a 16 entry table - small enough for the flash of an AVR and
+// still twice as fast as working bit by bit. Pass the result of one call as crc to the next to checksum
+// data that arrives in pieces.
+uint32_t flashCRC32(const void *data, size_t len, uint32_t crc = 0);
+
+#endif // FLASHCRC_H
@@ -0,0 +1,281 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashCommit.h"
+#include "FlashCRC.h"
+
+// Constructor
+//  Takes three arguments -
+//    1. flash --> The SPIFlash object to store the commits in. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the commits. Only whole sectors inside the region are used
+//    3. size --> Size of the region - in number of bytes. Must hold at least two sectors
+FlashCommit::FlashCommit(SPIFlash &flash, uint32_t startAddr, uint32_t size) {
+  _flash = &flash;
+  _startAddr = (startAddr + COMMIT_SECTORSIZE - 1) - ((startAddr + COMMIT_SECTORSIZE - 1) % COMMIT_SECTORSIZE);
+  uint32_t _endAddr = (startAddr + size) - ((startAddr + size) % COMMIT_SECTORSIZE);
+  _numSectors = (_endAddr > _startAddr) ? (_endAddr - _startAddr) / COMMIT_SECTORSIZE : 0;
+  _valid = false;
+  _cAddr = _cSeq = _nextSeq = 0;
+  _cLen = 0;
+  _wSector = _wOffset = 0;
+  _wFresh = true;
+}
+
+// Finds the latest complete commit. The sector holding the newest commits is found from the first commit record
+// in every sector, then its commit records are followed from one to the next. Data that fails its CRC is ignored
+// and the commit before it is used instead. If the last commit was cut short the next one goes to a fresh sector.
+// Must be called before the first commit.
+bool FlashCommit::begin() {
+  if (!_flash->getCapacity() || _numSectors < 2) {
+    return false;
+  }
+  _valid = false;
+  _nextSeq = 0;
+  // Until a commit record is found the first commit goes to sector 0
+  _wSector = _numSectors - 1;
+  _wOffset = 0;
+  _wFresh = true;
+
+  uint32_t _below = 0xFFFFFFFF;
+  for (uint16_t _try = 0; _try < _numSectors && !_valid; _try++) {
+    // Newest sector not looked at yet
+    int32_t _sector = -1;
+    uint32_t _seq = 0;
+    for (uint16_t s = 0; s < _numSectors; s++) {
+      if (_readRecord(_sectorAddr(s)) && _rec.seq < _below && (_sector < 0 || _rec.seq > _seq)) {
+        _sector = s;
+        _seq = _rec.seq;
+      }
+    }
+    if (_sector < 0) {
+      break;
+    }
+    _below = _seq;
+
+    uint32_t _addr = _sectorAddr(_sector);
+    uint16_t _offset = 0;
+    while (_offset + sizeof(_rec) <= COMMIT_SECTORSIZE && _readRecord(_addr + _offset)) {
+      if (_rec.seq >= _nextSeq) {
+        _nextSeq = _rec.seq + 1;
+      }
+      if (_flashCRC(_addr + _offset + sizeof(_rec), _rec.len) == _rec.crc) {
+        _valid = true;
+        _cAddr = _addr + _offset + sizeof(_rec);
+        _cLen = _rec.len;
+        _cSeq = _rec.seq;
+      }
+      _offset += sizeof(_rec) + _rec.len;
+      _offset += (COMMIT_ALIGN - _offset % COMMIT_ALIGN) % COMMIT_ALIGN;
+    }
+    if (!_try) {
+      // The next commit goes after the last commit record in the newest sector - unless a commit
+      // that was cut short has left data behind
+      _wSector = _sector;
+      _wOffset = _offset;
+      _wFresh = (_offset < COMMIT_SECTORSIZE) && !_isBlank(_addr + _offset, COMMIT_SECTORSIZE - _offset);
+    }
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+uint32_t FlashCommit::_sectorAddr(uint16_t sector) {
+  return _startAddr + (uint32_t)sector * COMMIT_SECTORSIZE;
+}
+
+// Reads the commit record at an address into _rec. Returns false if there is no intact commit record there.
+bool FlashCommit::_readRecord(uint32_t addr) {
+  if (!_flash->readByteArray(addr, (uint8_t*)&_rec, sizeof(_rec))) {
+    return false;
+  }
+  return _rec.magic == COMMIT_MAGIC && _rec.len <= COMMIT_SECTORSIZE - sizeof(_rec) &&
+         _rec.hdrcrc == flashCRC32(&_rec, offsetof(commitRecord, hdrcrc));
+}
+
+// Returns the CRC of data in the flash memory
+uint32_t FlashCommit::_flashCRC(uint32_t addr, uint16_t len) {
+  uint8_t _buf[COMMIT_CHUNK];
+  uint32_t _crc = 0;
+  while (len) {
+    uint16_t _n = (len > COMMIT_CHUNK) ? COMMIT_CHUNK : len;
+    if (!_flash->readByteArray(addr, _buf, _n)) {
+      return ~_crc;
+    }
+    _crc = flashCRC32(_buf, _n, _crc);
+    addr += _n;
+    len -= _n;
+  }
+  return _crc;
+}
+
+bool FlashCommit::_isBlank(uint32_t addr, uint32_t len) {
+  uint8_t _buf[COMMIT_CHUNK];
+  while (len) {
+    uint16_t _n = (len > COMMIT_CHUNK) ? COMMIT_CHUNK : len;
+    if (!_flash->readByteArray(addr, _buf, _n)) {
+      return false;
+    }
+    for (uint16_t i = 0; i < _n; i++) {
+      if (_buf[i] != 0xFF) {
+        return false;
+      }
+    }
+    addr += _n;
+    len -= _n;
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                      Write / Read functions                        //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Atomically replaces the stored data with data gathered from a number of buffers. Either all of the parts
+// are stored or - if the commit is cut short - none of them.
+//  Takes two arguments -
+//    1. parts --> Array of parts. The addr of each part is its offset in the data. Bytes not covered by any
+//       part read back as 0xFF. Parts must not overlap
+//    2. n --> Number of parts in the array. Must be from 1 to COMMIT_MAXPARTS
+bool FlashCommit::commit(const FlashIOVec *parts, size_t n) {
+  if (!n || n > COMMIT_MAXPARTS) {
+    return false;
+  }
+  uint32_t _len = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (parts[i].addr + parts[i].len > _len) {
+      _len = parts[i].addr + parts[i].len;
+    }
+  }
+  if (_len > COMMIT_SECTORSIZE - sizeof(_rec)) {
+    return false;
+  }
+
+  // CRC of the data as it will read back - parts in order of offset and 0xFF in the gaps between them
+  uint32_t _crc = 0;
+  uint32_t _pos = 0;
+  const uint8_t _blank = 0xFF;
+  while (_pos < _len) {
+    uint32_t _next = _len;
+    size_t i = 0;
+    for (; i < n; i++) {
+      if (parts[i].addr <= _pos && _pos < parts[i].addr + parts[i].len) {
+        break;
+      }
+      if (parts[i].addr > _pos && parts[i].addr < _next) {
+        _next = parts[i].addr;
+      }
+    }
+    if (i < n) {
+      _crc = flashCRC32(&parts[i].buffer[_pos - parts[i].addr], parts[i].addr + parts[i].len - _pos, _crc);
+      _pos = parts[i].addr + parts[i].len;
+    }
+    else {
+      for (; _pos < _next; _pos++) {
+        _crc = flashCRC32(&_blank, 1, _crc);
+      }
+    }
+  }
+
+  if (_wFresh || _wOffset + sizeof(_rec) + _len > COMMIT_SECTORSIZE) {
+    // Move on to the next sector. The latest commit is in the current one, so only older commits are lost
+    _wSector = (_wSector + 1) % _numSectors;
+    _wOffset = 0;
+    if (!_isBlank(_sectorAddr(_wSector), COMMIT_SECTORSIZE) && !_flash->eraseSector(_sectorAddr(_wSector))) {
+      return false;
+    }
+    _wFresh = false;
+  }
+
+  // The data goes in first, leaving the commit record blank
+  uint32_t _addr = _sectorAddr(_wSector) + _wOffset;
+  FlashIOVec _v[COMMIT_MAXPARTS];
+  for (size_t i = 0; i < n; i++) {
+    _v[i].addr = _addr + sizeof(_rec) + parts[i].addr;
+    _v[i].buffer = parts[i].buffer;
+    _v[i].len = parts[i].len;
+  }
+  if (!_flash->writev(_v, n, false) || _flashCRC(_addr + sizeof(_rec), _len) != _crc) {
+    _wFresh = true;
+    return false;
+  }
+
+  // Then the commit record makes it count
+  _rec.magic = COMMIT_MAGIC;
+  _rec.len = _len;
+  _rec.seq = _nextSeq;
+  _rec.crc = _crc;
+  _rec.hdrcrc = flashCRC32(&_rec, offsetof(commitRecord, hdrcrc));
+  if (!_flash->writeByteArray(_addr, (uint8_t*)&_rec, sizeof(_rec))) {
+    _wFresh = true;
+    return false;
+  }
+  _valid = true;
+  _cAddr = _addr + sizeof(_rec);
+  _cLen = _len;
+  _cSeq = _nextSeq++;
+  _wOffset += sizeof(_rec) + _len;
+  _wOffset += (COMMIT_ALIGN - _wOffset % COMMIT_ALIGN) % COMMIT_ALIGN;
+  return true;
+}
+
+// Atomically replaces the stored data with the contents of a buffer.
+//  Takes two arguments -
+//    1. data --> Buffer holding the data
+//    2. len --> Size of the buffer - in number of bytes
+bool FlashCommit::commit(const void *data, uint16_t len) {
+  FlashIOVec _part;
+  _part.addr = 0;
+  _part.buffer = (uint8_t*)data;
+  _part.len = len;
+  return commit(&_part, 1);
+}
+
+// Reads from the data stored by the latest commit.
+//  Takes three arguments -
+//    1. offset --> Offset in the data to start reading from
+//    2. buffer --> Buffer to read the data into
+//    3. len --> Number of bytes to read
+bool FlashCommit::read(uint16_t offset, void *buffer, uint16_t len) {
+  if (!_valid || (uint32_t)offset + len > _cLen) {
+    return false;
+  }
+  return _flash->readByteArray(_cAddr + offset, (uint8_t*)buffer, len);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Information functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the length of the data stored by the latest commit. 0 if nothing has been committed yet
+uint16_t FlashCommit::length() {
+  return _valid ? _cLen : 0;
+}
+
+// Returns the sequence number of the latest commit. Goes up by one with every commit
+uint32_t FlashCommit::sequence() {
+  return _cSeq;
+}
@@ -0,0 +1,84 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHCOMMIT_H
+#define FLASHCOMMIT_H
+
+#include "SPIFlash.h"
+
+#define COMMIT_SECTORSIZE   KB(4)
+#define COMMIT_MAGIC        0xC0A1
+#define COMMIT_ALIGN        4
+#define COMMIT_CHUNK        32          // Size of the buffer used to checksum data in the flash memory
+#define COMMIT_MAXPARTS     8           // Most parts a commit can be gathered from - each takes a FlashIOVec of stack
+
+// Stores a block of related data - a header, a payload and an index, say - so that it is always updated as a
+// whole. Each commit appends the data to a ring of sectors, followed by a small commit record holding its
+// length, a sequence number and CRCs. The commit record is programmed last, so a reset part way through a
+// commit leaves no commit record and begin() goes on using the previous commit. Every byte is written once,
+// plus 16 bytes for the commit record. A commit never spans two sectors, so it can be up to 4080 bytes long,
+// and the ring needs at least two sectors so that the latest commit survives while the next sector is erased.
+class FlashCommit {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashCommit(SPIFlash &flash, uint32_t startAddr, uint32_t size);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin();
+  //-------------------------------- Write / Read functions -----------------------------//
+  bool     commit(const FlashIOVec *parts, size_t n);
+  bool     commit(const void *data, uint16_t len);
+  bool     read(uint16_t offset, void *buffer, uint16_t len);
+  //-------------------------------- Information functions ------------------------------//
+  uint16_t length();
+  uint32_t sequence();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _readRecord(uint32_t addr);
+  uint32_t _flashCRC(uint32_t addr, uint16_t len);
+  bool     _isBlank(uint32_t addr, uint32_t len);
+  uint32_t _sectorAddr(uint16_t sector);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  uint32_t    _startAddr;
+  uint16_t    _numSectors;
+  struct      commitRecord {
+                uint16_t magic;
+                uint16_t len;
+                uint32_t seq;
+                uint32_t crc;       // CRC of the data
+                uint32_t hdrcrc;    // CRC of the fields above
+              };
+              commitRecord _rec;
+  // Latest commit
+  bool        _valid;
+  uint32_t    _cAddr, _cSeq;        // _cAddr is the address of its data
+  uint16_t    _cLen;
+  uint32_t    _nextSeq;
+  // Writer
+  uint16_t    _wSector, _wOffset;
+  bool        _wFresh;              // The writer has to move on to a fresh sector before the next commit
+};
+
+#endif // FLASHCOMMIT_H
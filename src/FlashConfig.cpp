@@ -0,0 +1,162 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashConfig.h"
+#include "FlashCRC.h"
+
+// Constructor
+//  Takes four arguments -
+//    1. flash --> The SPIFlash object to store the versions in. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the versions. Only whole sectors inside the region are used
+//    3. size --> Size of the region - in number of bytes. Must hold at least two sectors
+//    4. dataSize --> Size of the struct - in number of bytes
+FlashConfigBase::FlashConfigBase(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint16_t dataSize) {
+  _flash = &flash;
+  _startAddr = (startAddr + CONFIG_SECTORSIZE - 1) - ((startAddr + CONFIG_SECTORSIZE - 1) % CONFIG_SECTORSIZE);
+  uint32_t _endAddr = (startAddr + size) - ((startAddr + size) % CONFIG_SECTORSIZE);
+  _numSectors = (_endAddr > _startAddr) ? (_endAddr - _startAddr) / CONFIG_SECTORSIZE : 0;
+  _dataSize = dataSize;
+  _slotSize = 16;
+  while (_slotSize < sizeof(slotHeader) + dataSize && _slotSize < CONFIG_SECTORSIZE) {
+    _slotSize <<= 1;
+  }
+  _perSector = (sizeof(slotHeader) + dataSize <= _slotSize) ? CONFIG_SECTORSIZE / _slotSize : 0;
+  _seq = 0;
+  _wSector = _wSlot = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+uint32_t FlashConfigBase::_slotAddr(uint16_t sector, uint16_t slot) {
+  return _startAddr + (uint32_t)sector * CONFIG_SECTORSIZE + (uint32_t)slot * _slotSize;
+}
+
+uint32_t FlashConfigBase::_slotSeq(uint16_t sector, uint16_t slot) {
+  uint32_t _s;
+  if (!_flash->readByteArray(_slotAddr(sector, slot), (uint8_t*)&_s, sizeof(_s))) {
+    return CONFIG_BLANK;
+  }
+  return _s;
+}
+
+// Reads the data in a slot. Returns its sequence number - or CONFIG_DEAD if the slot is blank, damaged or fails its CRC.
+uint32_t FlashConfigBase::_readSlot(uint16_t sector, uint16_t slot, uint8_t *data) {
+  slotHeader _hdr;
+  uint32_t _addr = _slotAddr(sector, slot);
+  if (!_flash->readByteArray(_addr, (uint8_t*)&_hdr, sizeof(_hdr)) || _hdr.seq == CONFIG_BLANK || _hdr.seq == CONFIG_DEAD) {
+    return CONFIG_DEAD;
+  }
+  if (!_flash->readByteArray(_addr + sizeof(_hdr), data, _dataSize)) {
+    return CONFIG_DEAD;
+  }
+  if (flashCRC32(data, _dataSize, flashCRC32(&_hdr.seq, sizeof(_hdr.seq))) != _hdr.crc) {
+    return CONFIG_DEAD;
+  }
+  return _hdr.seq;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Protected functions                         //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Finds the newest intact version and reads it into data. The sector holding it is the one whose first slot holds
+// the highest sequence number. Slots are written in order, so the first free slot in that sector is found with a
+// binary search and the newest version is the last intact slot before it. Sets _seq to 0 if nothing is stored.
+bool FlashConfigBase::_begin(uint8_t *data) {
+  _seq = 0;
+  _wSector = _wSlot = 0;
+  if (!_flash->getCapacity() || _numSectors < 2 || !_perSector) {
+    return false;
+  }
+
+  int32_t _newest = -1;
+  uint32_t _newestSeq = 0;
+  for (uint16_t s = 0; s < _numSectors; s++) {
+    uint32_t _s = _readSlot(s, 0, data);
+    if (_s != CONFIG_DEAD && (_newest < 0 || _s > _newestSeq)) {
+      _newest = s;
+      _newestSeq = _s;
+    }
+  }
+  if (_newest < 0) {
+    return true;
+  }
+
+  uint16_t _lo = 1, _hi = _perSector;
+  while (_lo < _hi) {
+    uint16_t _mid = (_lo + _hi) / 2;
+    if (_slotSeq(_newest, _mid) == CONFIG_BLANK) {
+      _hi = _mid;
+    }
+    else {
+      _lo = _mid + 1;
+    }
+  }
+  _wSector = _newest;
+  _wSlot = _lo;
+  // A save that was cut short leaves a slot that fails its CRC - step back over it
+  for (uint16_t i = _lo; i-- > 0;) {
+    _seq = _readSlot(_newest, i, data);
+    if (_seq != CONFIG_DEAD) {
+      break;
+    }
+  }
+  return true;
+}
+
+// Writes a new version to the next free slot, erasing the next sector in the ring once the current one is full.
+// A slot that turns out not to be blank is marked dead and skipped.
+bool FlashConfigBase::_save(const uint8_t *data) {
+  slotHeader _hdr;
+  _hdr.seq = _seq + 1;
+  _hdr.crc = flashCRC32(data, _dataSize, flashCRC32(&_hdr.seq, sizeof(_hdr.seq)));
+
+  for (uint16_t _try = 0; _try <= _perSector; _try++) {
+    if (_wSlot >= _perSector) {
+      _wSector = (_wSector + 1) % _numSectors;
+      _wSlot = 0;
+    }
+    if (!_wSlot && !_flash->eraseSector(_slotAddr(_wSector, 0))) {
+      return false;
+    }
+    uint32_t _addr = _slotAddr(_wSector, _wSlot++);
+    FlashIOVec _v[2];
+    _v[0].addr = _addr;
+    _v[0].buffer = (uint8_t*)&_hdr;
+    _v[0].len = sizeof(_hdr);
+    _v[1].addr = _addr + sizeof(_hdr);
+    _v[1].buffer = (uint8_t*)data;
+    _v[1].len = _dataSize;
+    if (_flash->writev(_v, 2)) {
+      _seq = _hdr.seq;
+      return true;
+    }
+    // Keep the slot from looking blank to the binary search in _begin()
+    uint32_t _dead = CONFIG_DEAD;
+    _flash->writeByteArray(_addr, (uint8_t*)&_dead, sizeof(_dead), false);
+  }
+  return false;
+}
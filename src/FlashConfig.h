@@ -0,0 +1,120 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHCONFIG_H
+#define FLASHCONFIG_H
+
+#include "SPIFlash.h"
+
+#define CONFIG_SECTORSIZE   KB(4)
+#define CONFIG_BLANK        0xFFFFFFFF
+#define CONFIG_DEAD         0x00000000    // Marks a slot that was found damaged and skipped
+
+// Does the work for FlashConfig<T> - see below.
+class FlashConfigBase {
+protected:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashConfigBase(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint16_t dataSize);
+  //------------------------------- Protected functions ---------------------------------//
+  bool     _begin(uint8_t *data);
+  bool     _save(const uint8_t *data);
+  //------------------------------- Protected variables ---------------------------------//
+  uint32_t    _seq;                       // Sequence number of the version in RAM. 0 if nothing was stored yet
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  uint32_t _readSlot(uint16_t sector, uint16_t slot, uint8_t *data);
+  uint32_t _slotSeq(uint16_t sector, uint16_t slot);
+  uint32_t _slotAddr(uint16_t sector, uint16_t slot);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  uint32_t    _startAddr;
+  uint16_t    _numSectors, _dataSize, _slotSize, _perSector;
+  uint16_t    _wSector, _wSlot;           // Next slot to be written
+  struct      slotHeader {
+                uint32_t seq;
+                uint32_t crc;             // CRC of the sequence number and the data
+              };
+};
+
+// Keeps a configuration struct in the flash memory without erasing a sector on every save. Each save writes the
+// next version of the struct to the next free slot in a ring of sectors, along with a sequence number and a CRC,
+// so a sector is only erased once all of its slots are used up. Slots are sized to the next power of two, so as
+// long as a slot fits in a page each save costs a single page program. begin() finds the newest intact version
+// with a binary search and keeps a copy in RAM, so get() never touches the flash.
+template <class T> class FlashConfig : public FlashConfigBase {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashConfig(SPIFlash &flash, uint32_t startAddr, uint32_t size) : FlashConfigBase(flash, startAddr, size, sizeof(T)) {}
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin(const T& defaults);
+  //-------------------------------- Write / Read functions -----------------------------//
+  bool     save(const T& value);
+  const T& get();
+  //-------------------------------- Information functions ------------------------------//
+  uint32_t version();
+
+private:
+  T           _value;
+};
+
+//--------------------------------- Public Templates ------------------------------------//
+
+// Loads the newest version of the struct stored in the flash memory - or the defaults if there is none.
+// Must be called before the first save.
+//  Takes one argument -
+//    1. defaults --> Value to use if no version has been stored yet
+template <class T> bool FlashConfig<T>::begin(const T& defaults) {
+  bool _ok = _begin((uint8_t*)(void*)&_value);
+  if (!_seq) {
+    _value = defaults;
+  }
+  return _ok;
+}
+
+// Stores a new version of the struct. Does nothing if it is the same as the version in RAM.
+//  Takes one argument -
+//    1. value --> New version of the struct
+template <class T> bool FlashConfig<T>::save(const T& value) {
+  if (_seq && !memcmp(&value, &_value, sizeof(T))) {
+    return true;
+  }
+  if (!_save((const uint8_t*)(const void*)&value)) {
+    return false;
+  }
+  _value = value;
+  return true;
+}
+
+// Returns the copy of the newest version kept in RAM
+template <class T> const T& FlashConfig<T>::get() {
+  return _value;
+}
+
+// Returns the sequence number of the newest version. Goes up by one with every save - 0 if nothing is stored yet
+template <class T> uint32_t FlashConfig<T>::version() {
+  return _seq;
+}
+
+#endif // FLASHCONFIG_H
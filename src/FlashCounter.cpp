@@ -0,0 +1,158 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashCounter.h"
+
+// Constructor
+//  Takes three arguments -
+//    1. flash --> The SPIFlash object to keep the count in. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the count. Only whole sectors inside the region are used
+//    3. size --> Size of the region - in number of bytes. Must hold at least two sectors
+FlashCounter::FlashCounter(SPIFlash &flash, uint32_t startAddr, uint32_t size) {
+  _flash = &flash;
+  _startAddr = (startAddr + COUNTER_SECTORSIZE - 1) - ((startAddr + COUNTER_SECTORSIZE - 1) % COUNTER_SECTORSIZE);
+  uint32_t _endAddr = (startAddr + size) - ((startAddr + size) % COUNTER_SECTORSIZE);
+  _numSectors = (_endAddr > _startAddr) ? (_endAddr - _startAddr) / COUNTER_SECTORSIZE : 0;
+  _sector = -1;
+  _seq = _base = _count = 0;
+}
+
+// Finds the sector in use - the one with the highest sequence number in its header - and counts the bits
+// cleared in it. Must be called before the first increment.
+bool FlashCounter::begin() {
+  _sector = -1;
+  _seq = _base = _count = 0;
+  if (!_flash->getCapacity() || _numSectors < 2) {
+    return false;
+  }
+  counterHeader _hdr;
+  for (uint16_t s = 0; s < _numSectors; s++) {
+    if (_readHeader(s, _hdr) && (_sector < 0 || _hdr.seq > _seq)) {
+      _sector = s;
+      _seq = _hdr.seq;
+      _base = _hdr.base;
+    }
+  }
+  if (_sector < 0) {
+    return true;
+  }
+
+  uint32_t _buf[COUNTER_CHUNK / sizeof(uint32_t)];
+  uint32_t _addr = _sectorAddr(_sector) + sizeof(counterHeader);
+  for (uint16_t i = 0; i < COUNTER_SECTORSIZE - sizeof(counterHeader); i += COUNTER_CHUNK) {
+    uint16_t _n = COUNTER_SECTORSIZE - sizeof(counterHeader) - i;
+    if (_n > COUNTER_CHUNK) {
+      _n = COUNTER_CHUNK;
+    }
+    if (!_flash->readByteArray(_addr + i, (uint8_t*)_buf, _n)) {
+      return false;
+    }
+    for (uint8_t j = 0; j < _n / sizeof(uint32_t); j++) {
+      _count += 32 - __builtin_popcountl(_buf[j]);
+    }
+    // Bits are cleared in order, so nothing follows the first word that is still blank
+    if (_buf[_n / sizeof(uint32_t) - 1] == 0xFFFFFFFF) {
+      break;
+    }
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+uint32_t FlashCounter::_sectorAddr(uint16_t sector) {
+  return _startAddr + (uint32_t)sector * COUNTER_SECTORSIZE;
+}
+
+bool FlashCounter::_readHeader(uint16_t sector, counterHeader &hdr) {
+  if (!_flash->readByteArray(_sectorAddr(sector), (uint8_t*)&hdr, sizeof(hdr))) {
+    return false;
+  }
+  return hdr.magic == COUNTER_MAGIC && hdr.check == ~(hdr.seq ^ hdr.base);
+}
+
+// Moves the count on to the next sector in the ring, with base as its starting value. The sector in use is only
+// given up once the new header is complete, so a reset part way through leaves the count where it was.
+bool FlashCounter::_roll(uint32_t base) {
+  uint16_t _next = (_sector < 0) ? 0 : (_sector + 1) % _numSectors;
+  counterHeader _hdr;
+  _hdr.magic = COUNTER_MAGIC;
+  _hdr.seq = (_sector < 0) ? 0 : _seq + 1;
+  _hdr.base = base;
+  _hdr.check = ~(_hdr.seq ^ _hdr.base);
+  if (!_flash->eraseSector(_sectorAddr(_next)) || !_flash->writeByteArray(_sectorAddr(_next), (uint8_t*)&_hdr, sizeof(_hdr))) {
+    return false;
+  }
+  _sector = _next;
+  _seq = _hdr.seq;
+  _base = base;
+  _count = 0;
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                          Counter functions                         //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Adds to the count by clearing the next bits in the sector in use. Clearing up to eight bits programs a single
+// byte. If the sector does not have enough bits left the count moves on to the next sector instead.
+//  Takes one argument -
+//    1. by --> Optional. Amount to add - 1 by default
+bool FlashCounter::increment(uint32_t by) {
+  if (!by) {
+    return true;
+  }
+  if (_sector < 0 || _count + by > COUNTER_BITS) {
+    return _roll(value() + by);
+  }
+
+  // Bytes from the one holding the first bit to be cleared to the one holding the last. Bits are cleared from
+  // bit 0 up, so each byte ends up as 0xFF shifted left by the number of its bits that are cleared.
+  uint32_t _first = _count / 8, _last = (_count + by - 1) / 8;
+  uint8_t _buf[COUNTER_CHUNK];
+  uint32_t i = _first;
+  while (i <= _last) {
+    uint16_t _n = 0;
+    for (; i <= _last && _n < COUNTER_CHUNK; i++, _n++) {
+      uint32_t _cleared = _count + by - i * 8;
+      _buf[_n] = (_cleared >= 8) ? 0x00 : (uint8_t)(0xFF << _cleared);
+    }
+    bool _blankCheck = _flash->getBlankCheck();
+    _flash->setBlankCheck(false);
+    bool _ok = _flash->writeByteArray(_sectorAddr(_sector) + sizeof(counterHeader) + i - _n, _buf, _n);
+    _flash->setBlankCheck(_blankCheck);
+    if (!_ok) {
+      return false;
+    }
+  }
+  _count += by;
+  return true;
+}
+
+// Returns the count
+uint32_t FlashCounter::value() {
+  return _base + _count;
+}
@@ -0,0 +1,72 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHCOUNTER_H
+#define FLASHCOUNTER_H
+
+#include "SPIFlash.h"
+
+#define COUNTER_SECTORSIZE  KB(4)
+#define COUNTER_MAGIC       0xC0DE0001
+#define COUNTER_BITS        ((COUNTER_SECTORSIZE - sizeof(FlashCounter::counterHeader)) * 8)
+#define COUNTER_CHUNK       64            // Size of the buffer used to count the bits - in number of bytes
+
+// Keeps a count - boot count, cycle count, odometer - in the flash memory without erasing on every increment.
+// NOR flash can program any 1 bit to 0 without an erase, so the count is kept as the number of bits cleared in a
+// sector, one after the other, on top of a base value stored in the sector's header. An increment programs a
+// single byte. Once all 32640 bits of a sector are cleared the count rolls over into the next sector of the
+// ring, which is erased and gets the count so far as its base. begin() counts the cleared bits 32 at a time.
+// WARNING: Increments turn the check for previously written data off while they program and back on afterwards
+// (see setBlankCheck()).
+class FlashCounter {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashCounter(SPIFlash &flash, uint32_t startAddr, uint32_t size);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin();
+  //---------------------------------- Counter functions --------------------------------//
+  bool     increment(uint32_t by = 1);
+  uint32_t value();
+
+  struct      counterHeader {
+                uint32_t magic;
+                uint32_t seq;
+                uint32_t base;
+                uint32_t check;             // ~(seq ^ base) - tells a complete header from one that was cut short
+              };
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _readHeader(uint16_t sector, counterHeader &hdr);
+  bool     _roll(uint32_t base);
+  uint32_t _sectorAddr(uint16_t sector);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  uint32_t    _startAddr;
+  uint16_t    _numSectors;
+  int32_t     _sector;                      // Sector in use. -1 until the first increment
+  uint32_t    _seq, _base, _count;          // _count is the number of bits cleared in the sector in use
+};
+
+#endif // FLASHCOUNTER_H
@@ -0,0 +1,312 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashQueue.h"
+
+// Constructor
+//  Takes one argument -
+//    1. flash --> The SPIFlash object the requests go to. begin() must have been called on it before the first call to service()
+FlashQueue::FlashQueue(SPIFlash &flash) {
+  _flash = &flash;
+  _count = 0;
+  _dataHead = 0;
+  _failed = false;
+  _job.state = JOB_IDLE;
+  resetStats();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Adds a request to the end of the queue. Returns false if the queue is full.
+bool FlashQueue::_add(uint8_t type, uint32_t addr, uint32_t size, uint8_t *buffer, uint16_t data, FlashQueueCallback callback, void *arg) {
+  if (_count == QUEUE_DEPTH) {
+    return false;
+  }
+  FlashQueueEntry &_e = _queue[_count++];
+  _e.type = type;
+  _e.started = false;
+  _e.addr = addr;
+  _e.size = size;
+  _e.buffer = buffer;
+  _e.data = data;
+  _e.queued = micros();
+  _e.callback = callback;
+  _e.arg = arg;
+  _stats.op[type].requests++;
+  return true;
+}
+
+// Checks if the request at position i in the queue touches any byte from addr to addr + size
+bool FlashQueue::_overlaps(uint8_t i, uint32_t addr, uint32_t size) {
+  return _queue[i].addr < addr + size && addr < _queue[i].addr + _queue[i].size;
+}
+
+// Checks if the read at position i in the queue has to wait for a write or erase queued before it
+bool FlashQueue::_blocked(uint8_t i) {
+  for (uint8_t j = 0; j < i; j++) {
+    if (_queue[j].type != QUEUE_READ && _overlaps(j, _queue[i].addr, _queue[i].size)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Finds room for size bytes of write data in the data buffer. The data buffer is used as a ring - writes complete in the
+// order they were queued, so the oldest write still in the queue holds the start of the part in use.
+// Returns the offset of the room found, or QUEUE_DATASIZE if there is none.
+uint16_t FlashQueue::_alloc(uint16_t size) {
+  uint8_t i = 0;
+  while (i < _count && _queue[i].type != QUEUE_WRITE) {
+    i++;
+  }
+  if (i == _count) {
+    return (size <= QUEUE_DATASIZE) ? 0 : QUEUE_DATASIZE;
+  }
+  uint16_t _tail = _queue[i].data;
+  if (_dataHead > _tail) {
+    // The part in use does not wrap around - use the end of the buffer, or else the start
+    if (_dataHead + size <= QUEUE_DATASIZE) {
+      return _dataHead;
+    }
+    return (size <= _tail) ? 0 : QUEUE_DATASIZE;
+  }
+  return (_dataHead + size <= _tail) ? _dataHead : QUEUE_DATASIZE;
+}
+
+// Takes the request at position i off the queue, records its latency and calls its callback
+void FlashQueue::_complete(uint8_t i, bool ok) {
+  FlashQueueEntry _e = _queue[i];
+  _count--;
+  memmove(&_queue[i], &_queue[i + 1], (_count - i) * sizeof(FlashQueueEntry));
+
+  FlashQueueOpStats &_op = _stats.op[_e.type];
+  uint32_t _latency = micros() - _e.queued;
+  _op.completed++;
+  _op.totalTime += _latency;
+  if (_latency > _op.maxTime) {
+    _op.maxTime = _latency;
+  }
+  if (!ok) {
+    _op.errors++;
+    _failed = true;
+  }
+  if (_e.callback) {
+    _e.callback(ok, _e.arg);
+  }
+}
+
+// Serves every read that does not have to wait for a write or erase, with as few read instructions as possible.
+// Returns false if there were none.
+bool FlashQueue::_serveReads() {
+  FlashIOVec _v[QUEUE_DEPTH];
+  uint8_t _index[QUEUE_DEPTH];
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_queue[i].type == QUEUE_READ && !_blocked(i)) {
+      _v[n].addr = _queue[i].addr;
+      _v[n].buffer = _queue[i].buffer;
+      _v[n].len = _queue[i].size;
+      _index[n++] = i;
+    }
+  }
+  if (!n) {
+    return false;
+  }
+  bool _ok = _flash->readv(_v, n);
+  // Newest first, so that taking a read off the queue does not move the ones still to be taken off
+  while (n) {
+    _complete(_index[--n], _ok);
+  }
+  return true;
+}
+
+// Moves the write or erase in progress along, or starts the oldest one in the queue if none is in progress. Once one
+// completes the next one is left to the following call, so that reads it held up are served first.
+void FlashQueue::_serveJob() {
+  uint8_t i = 0;
+  while (i < _count && _queue[i].type == QUEUE_READ) {
+    i++;
+  }
+  if (i == _count) {
+    return;
+  }
+  FlashQueueEntry &_e = _queue[i];
+  if (_e.started) {
+    _flash->poll();
+  }
+  else {
+    bool _ok;
+    if (_e.type == QUEUE_WRITE) {
+      _ok = _flash->writeByteArrayAsync(_e.addr, &_data[_e.data], _e.size, _job);
+    }
+    else {
+      _ok = _flash->eraseSectionAsync(_e.addr, _e.size, _job);
+    }
+    if (!_ok && _job.error == JOBRUNNING) {
+      // An erase or write started outside the queue is still running - try again on the next call
+      return;
+    }
+    _e.started = true;
+  }
+  if (_job.state != JOB_BUSY) {
+    _complete(i, _job.state == JOB_DONE);
+  }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                          Queue functions                           //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Queues a read. Returns false if the queue is full.
+//  Takes five arguments -
+//    1. addr --> Any address from 0 to capacity
+//    2. buffer --> Buffer to read the data into. Must stay in scope until the read has completed
+//    3. size --> Number of bytes to read
+//    4. callback --> Optional. Called from service() once the data is in the buffer, or the read has failed
+//    5. arg --> Passed to the callback
+bool FlashQueue::read(uint32_t addr, void *buffer, size_t size, FlashQueueCallback callback, void *arg) {
+  return _add(QUEUE_READ, addr, size, (uint8_t*)buffer, 0, callback, arg);
+}
+
+// Queues a write. The data is copied into the queue. A write without a callback that carries on where a write queued
+// before it ends is merged into it, as long as nothing queued in between touches the same addresses.
+// Returns false if the queue is full or has no room left for the data - call service() and try again.
+//  Takes five arguments -
+//    1. addr --> Any address from 0 to capacity
+//    2. data --> The data to be written
+//    3. size --> Size of the data - in number of bytes. At most QUEUE_DATASIZE
+//    4. callback --> Optional. Called from service() once the data has been written, or the write has failed
+//    5. arg --> Passed to the callback
+// WARNING: You can only write to previously erased memory locations (see datasheet).
+bool FlashQueue::write(uint32_t addr, const void *data, size_t size, FlashQueueCallback callback, void *arg) {
+  if (!size || size > QUEUE_DATASIZE) {
+    return false;
+  }
+  uint16_t _at = _alloc(size);
+  if (_at == QUEUE_DATASIZE) {
+    return false;
+  }
+  bool _merged = false;
+  if (!callback) {
+    for (uint8_t i = _count; i-- > 0; ) {
+      FlashQueueEntry &_e = _queue[i];
+      if (_e.type == QUEUE_WRITE && !_e.started && !_e.callback && _e.addr + _e.size == addr && _e.data + _e.size == _at) {
+        _e.size += size;
+        _stats.op[QUEUE_WRITE].requests++;
+        _stats.op[QUEUE_WRITE].merged++;
+        _merged = true;
+        break;
+      }
+      if (_overlaps(i, addr, size)) {
+        break;
+      }
+    }
+  }
+  if (!_merged && !_add(QUEUE_WRITE, addr, size, NULL, _at, callback, arg)) {
+    return false;
+  }
+  memcpy(&_data[_at], data, size);
+  _dataHead = _at + size;
+  return true;
+}
+
+// Queues an erase of the sectors containing a section of the flash memory - see eraseSection().
+// Returns false if the queue is full.
+//  Takes four arguments -
+//    1. addr --> Any address in the first sector to be erased
+//    2. size --> Size of the section - in number of bytes
+//    3. callback --> Optional. Called from service() once the section has been erased, or the erase has failed
+//    4. arg --> Passed to the callback
+bool FlashQueue::erase(uint32_t addr, uint32_t size, FlashQueueCallback callback, void *arg) {
+  uint32_t _start = addr - (addr % KB(4));
+  uint32_t _end = addr + (size ? size : 1);
+  if (_end % KB(4)) {
+    _end += KB(4) - (_end % KB(4));
+  }
+  return _add(QUEUE_ERASE, _start, _end - _start, NULL, 0, callback, arg);
+}
+
+// Runs the queue. Call it regularly from the main loop. Serves every read that is due and then moves the write or erase
+// in progress along as poll() does - within the time budget set with setTimeBudget(), if any.
+// Returns the number of requests still in the queue.
+uint8_t FlashQueue::service() {
+  _serveReads();
+  _serveJob();
+  return _count;
+}
+
+// Blocks until every request in the queue has completed. Returns false if any request has failed since the last call.
+bool FlashQueue::flush() {
+  while (service()) {
+    yield();
+  }
+  bool _ok = !_failed;
+  _failed = false;
+  return _ok;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                       Information functions                        //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of requests in the queue - including the write or erase in progress
+uint8_t FlashQueue::pending() {
+  return _count;
+}
+
+// Returns the latency statistics collected since the queue was created or the last call to resetStats().
+// The returned structure is updated in place - copy it to take a snapshot.
+const FlashQueueStats &FlashQueue::getStats() {
+  return _stats;
+}
+
+// Clears the statistics for all classes of request
+void FlashQueue::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+  _stats.since = micros();
+}
+
+// Prints the statistics as CSV - one line per class of request
+void FlashQueue::printStats(Print &out) {
+  const char *_names[QUEUE_CLASSES] = {"read", "write", "erase"};
+  out.println("class,requests,merged,completed,errors,meanLatency,maxLatency");
+  for (uint8_t i = 0; i < QUEUE_CLASSES; i++) {
+    const FlashQueueOpStats &_op = _stats.op[i];
+    out.print(_names[i]);
+    out.print(',');
+    out.print(_op.requests);
+    out.print(',');
+    out.print(_op.merged);
+    out.print(',');
+    out.print(_op.completed);
+    out.print(',');
+    out.print(_op.errors);
+    out.print(',');
+    out.print(_op.completed ? _op.totalTime / _op.completed : 0);
+    out.print(',');
+    out.println(_op.maxTime);
+  }
+}
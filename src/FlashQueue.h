@@ -0,0 +1,117 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHQUEUE_H
+#define FLASHQUEUE_H
+
+#include "SPIFlash.h"
+
+#define QUEUE_DEPTH     8             // Requests the queue can hold
+#define QUEUE_DATASIZE  256           // Bytes of write data the queue can hold
+#define QUEUE_READ      0             // Classes of request - index into FlashQueueStats::op
+#define QUEUE_WRITE     1
+#define QUEUE_ERASE     2
+#define QUEUE_CLASSES   3
+
+// Called from service() when a queued request has completed
+typedef void (*FlashQueueCallback)(bool ok, void *arg);
+
+// Latency statistics for one class of request - see getStats()
+// Latencies run from the call that queues a request to its completion and are in microseconds.
+// Merged requests complete with the request they were merged into, so the mean latency is totalTime / completed.
+struct FlashQueueOpStats {
+  uint32_t requests;    // Number of requests queued
+  uint32_t merged;      // Number of requests merged into one queued before them
+  uint32_t completed;   // Number of requests that have completed - counting merged ones once
+  uint32_t errors;      // Number of requests that failed
+  uint32_t totalTime;   // Sum of the latencies of the completed requests
+  uint32_t maxTime;     // Longest latency
+};
+
+// Snapshot of the statistics for every class of request - indexed by QUEUE_READ, QUEUE_WRITE & QUEUE_ERASE
+struct FlashQueueStats {
+  uint32_t          since;  // micros() at the time the statistics were last reset
+  FlashQueueOpStats op[QUEUE_CLASSES];
+};
+
+// One request waiting in the queue
+struct FlashQueueEntry {
+  uint8_t  type;        // QUEUE_READ, QUEUE_WRITE or QUEUE_ERASE
+  bool     started;     // Writes and erases only - the request is the job in progress
+  uint32_t addr;
+  uint32_t size;
+  uint8_t  *buffer;     // Reads only - buffer to read into
+  uint16_t data;        // Writes only - offset of the data in the data buffer of the queue
+  uint32_t queued;      // micros() when the request was queued
+  FlashQueueCallback callback;
+  void     *arg;
+};
+
+// Queues reads, writes and erases in front of a SPIFlash object and runs them from service(), which should be called
+// from the main loop. Reads are served ahead of the writes and erases queued before them, unless their address ranges
+// overlap - in which case they wait for the write or erase to complete. Writes and erases run one at a time, in the
+// order they were queued, as asynchronous jobs (see poll()), so a read never waits for more than the command in progress.
+// Reads that are due together are served in order of address, and adjacent ones by a single read instruction (see
+// readv()). A write that carries on where a queued write ends is merged into it, so a burst of small log writes is
+// programmed a page at a time.
+// Write data is copied into the queue, so the caller may reuse its buffer straight away. Read buffers must stay in
+// scope until the read has completed.
+// WARNING: Do not call the erase and write functions of the SPIFlash object directly while requests are queued.
+class FlashQueue {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashQueue(SPIFlash &flash);
+  //----------------------------------- Queue functions ---------------------------------//
+  bool     read(uint32_t addr, void *buffer, size_t size, FlashQueueCallback callback = NULL, void *arg = NULL);
+  bool     write(uint32_t addr, const void *data, size_t size, FlashQueueCallback callback = NULL, void *arg = NULL);
+  bool     erase(uint32_t addr, uint32_t size, FlashQueueCallback callback = NULL, void *arg = NULL);
+  uint8_t  service();
+  bool     flush();
+  //-------------------------------- Information functions ------------------------------//
+  uint8_t  pending();
+  const FlashQueueStats &getStats();
+  void     resetStats();
+  void     printStats(Print &out);
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _add(uint8_t type, uint32_t addr, uint32_t size, uint8_t *buffer, uint16_t data, FlashQueueCallback callback, void *arg);
+  bool     _overlaps(uint8_t i, uint32_t addr, uint32_t size);
+  bool     _blocked(uint8_t i);
+  uint16_t _alloc(uint16_t size);
+  void     _complete(uint8_t i, bool ok);
+  bool     _serveReads();
+  void     _serveJob();
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash        *_flash;
+  FlashQueueEntry _queue[QUEUE_DEPTH];  // Oldest first
+  uint8_t         _count;
+  FlashJob        _job;
+  uint8_t         _data[QUEUE_DATASIZE];
+  uint16_t        _dataHead;            // Where the data of the next write goes
+  bool            _failed;              // A request has failed since the last flush()
+  FlashQueueStats _stats;
+};
+
+#endif // FLASHQUEUE_H
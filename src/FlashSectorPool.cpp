@@ -0,0 +1,181 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashSectorPool.h"
+
+// Constructor
+//  Takes four arguments -
+//    1. flash --> The SPIFlash object the sectors belong to. begin() must have been called on it first
+//    2. startAddr --> Address of the region written to. Only whole sectors inside the region are used
+//    3. size --> Size of the region - in number of bytes
+//    4. ahead --> Number of sectors to keep erased ahead of the frontier. Less than the number of sectors in the region
+FlashSectorPool::FlashSectorPool(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint8_t ahead) {
+  _flash = &flash;
+  _startAddr = (startAddr + POOL_SECTORSIZE - 1) - ((startAddr + POOL_SECTORSIZE - 1) % POOL_SECTORSIZE);
+  uint32_t _endAddr = (startAddr + size) - ((startAddr + size) % POOL_SECTORSIZE);
+  _numSectors = (_endAddr > _startAddr) ? (_endAddr - _startAddr) / POOL_SECTORSIZE : 0;
+  _ahead = (_numSectors && ahead >= _numSectors) ? _numSectors - 1 : ahead;
+  _frontier = _ready = 0;
+  _erasing = false;
+  _job.state = JOB_IDLE;
+  _eraseStart = _eraseTime = 0;
+}
+
+// Finds out how many of the sectors ahead of the frontier are still erased - after a reboot, for example.
+// Erases that were cut short by a power loss leave a sector that is neither erased nor written, so every
+// sector is checked in full rather than by its first few bytes.
+//  Takes one argument -
+//    1. frontier --> Address the next write to the region goes to
+bool FlashSectorPool::begin(uint32_t frontier) {
+  if (!_numSectors || frontier < _startAddr || frontier >= _startAddr + (uint32_t)_numSectors * POOL_SECTORSIZE) {
+    return false;
+  }
+  if (_erasing && !_wait()) {
+    return false;
+  }
+  _frontier = (frontier - _startAddr) / POOL_SECTORSIZE;
+  _ready = 0;
+  while (_ready < _ahead && _isBlank(_ring(_frontier, _ready + 1))) {
+    _ready++;
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the sector n sectors after a sector, wrapping around at the end of the region
+uint16_t FlashSectorPool::_ring(uint16_t sector, uint16_t n) {
+  return (sector + n) % _numSectors;
+}
+
+// Waits for the erase started by service() to complete - for as long as the library allows an erase to take
+bool FlashSectorPool::_wait() {
+  if (_job.state == JOB_BUSY) {
+    _flash->waitJob();
+  }
+  return _erased();
+}
+
+// Books the erase started by service() as complete. Returns false if it failed - the sector is then erased again
+// by the next call to service(), or by ensure() if the frontier gets there first.
+bool FlashSectorPool::_erased() {
+  _erasing = false;
+  if (_job.state != JOB_DONE) {
+    return false;
+  }
+  if (millis() - _eraseStart > _eraseTime) {
+    _eraseTime = millis() - _eraseStart;
+  }
+  _ready++;
+  return true;
+}
+
+bool FlashSectorPool::_isBlank(uint16_t sector) {
+  uint8_t _buf[SPI_PAGESIZE];
+  uint32_t _addr = _startAddr + (uint32_t)sector * POOL_SECTORSIZE;
+  for (uint16_t i = 0; i < POOL_SECTORSIZE; i += SPI_PAGESIZE) {
+    if (!_flash->readByteArray(_addr + i, _buf, SPI_PAGESIZE)) {
+      return false;
+    }
+    for (uint16_t j = 0; j < SPI_PAGESIZE; j++) {
+      if (_buf[j] != 0xFF) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                           Pool functions                           //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Does a little erase-ahead work without ever waiting for the chip. Call it from loop() - or wherever the
+// sketch has time to spare. Either notes that the running erase has completed or starts the next one.
+// Returns false if an erase failed or could not be started. While an erase or write started by the sketch
+// itself is running, no erase is started.
+//  Takes one argument -
+//    1. idle --> Optional. Time left until the next write to the flash memory - in milliseconds. An erase that
+//       would still be running by then is not started, so the write does not have to wait for it
+bool FlashSectorPool::service(uint32_t idle) {
+  if (_erasing) {
+    if (_job.state == JOB_BUSY) {
+      _flash->poll(0);
+    }
+    if (_job.state == JOB_BUSY) {
+      return true;
+    }
+    if (!_erased()) {
+      return false;
+    }
+  }
+  if (_ready >= _ahead || idle < _eraseTime || _flash->isBusy()) {
+    return true;
+  }
+  _eraseStart = millis();
+  if (!_flash->eraseSectorAsync(_startAddr + (uint32_t)_ring(_frontier, _ready + 1) * POOL_SECTORSIZE, _job)) {
+    return _job.error == JOBRUNNING;      // The sketch's own erase or write - try again on the next call
+  }
+  _erasing = _job.state == JOB_BUSY;
+  if (!_erasing) {
+    return _erased();                     // Completed within the time budget of the call - see setTimeBudget()
+  }
+  return true;
+}
+
+// Makes sure that an address can be written to. Waits for an erase that is still running, then - if the address
+// is in a sector past the frontier - moves the frontier up to it, erasing any sector on the way that the pool
+// has not erased yet. Call it before every write to the region.
+//  Takes one argument -
+//    1. addr --> Address about to be written to
+bool FlashSectorPool::ensure(uint32_t addr) {
+  if (!_numSectors || addr < _startAddr || addr >= _startAddr + (uint32_t)_numSectors * POOL_SECTORSIZE) {
+    return false;
+  }
+  if (_erasing && !_wait()) {
+    return false;
+  }
+  uint16_t _sector = (addr - _startAddr) / POOL_SECTORSIZE;
+  while (_frontier != _sector) {
+    _frontier = _ring(_frontier, 1);
+    if (_ready) {
+      _ready--;
+    }
+    else if (!_flash->eraseSector(_startAddr + (uint32_t)_frontier * POOL_SECTORSIZE)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Information functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of sectors ahead of the frontier that are erased and ready to be written to
+uint8_t FlashSectorPool::ready() {
+  return _ready;
+}
@@ -0,0 +1,69 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHSECTORPOOL_H
+#define FLASHSECTORPOOL_H
+
+#include "SPIFlash.h"
+
+#define POOL_SECTORSIZE     KB(4)
+
+// Keeps a number of sectors ahead of the write frontier of a log - or of any other ring of sectors that is
+// written from start to end - erased, so that crossing into a new sector does not have to wait for an erase.
+// Erases are started from service(), which should be called whenever the sketch is idle, as asynchronous erase
+// jobs (see eraseSectorAsync()) and never wait for the chip. If service() is told how long the sketch is going to stay idle it only starts an erase that is
+// expected to complete in that time, judging by how long the erases before it took. Before writing to the
+// flash the writer calls ensure() with the address it is about to write to. This waits for an erase that is
+// still running and only erases a sector itself if the pool has run dry.
+// The chip cannot program while it erases, so ensure() must be called before every write - not only the
+// ones that cross into a new sector.
+class FlashSectorPool {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashSectorPool(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint8_t ahead = 2);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin(uint32_t frontier);
+  //----------------------------------- Pool functions ----------------------------------//
+  bool     service(uint32_t idle = 0xFFFFFFFF);
+  bool     ensure(uint32_t addr);
+  //-------------------------------- Information functions ------------------------------//
+  uint8_t  ready();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _wait();
+  bool     _erased();
+  bool     _isBlank(uint16_t sector);
+  uint16_t _ring(uint16_t sector, uint16_t n);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  uint32_t    _startAddr;
+  uint16_t    _numSectors, _frontier;     // _frontier is the sector being written to
+  uint8_t     _ahead, _ready;             // The _ready sectors after the frontier are erased
+  bool        _erasing;                   // The sector after those is being erased
+  FlashJob    _job;                       // The erase of that sector
+  uint32_t    _eraseStart, _eraseTime;    // Longest erase seen so far - in milliseconds
+};
+
+#endif // FLASHSECTORPOOL_H
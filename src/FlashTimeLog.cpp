@@ -0,0 +1,364 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashTimeLog.h"
+
+// Constructor
+//  Takes five arguments -
+//    1. flash --> The SPIFlash object to store the log in. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the log. Only whole sectors inside the region are used
+//    3. size --> Size of the region - in number of bytes. Must hold at least two sectors
+//    4. recordSize --> Size of one record - in number of bytes. A record and its timestamp must fit in TL_READBUFFER
+//    5. summary --> Optional array of one uint32_t per sector in the region. Speeds up find() at the cost of RAM
+FlashTimeLog::FlashTimeLog(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint16_t recordSize, uint32_t *summary) {
+  _flash = &flash;
+  _summary = summary;
+  _startAddr = (startAddr + TL_SECTORSIZE - 1) - ((startAddr + TL_SECTORSIZE - 1) % TL_SECTORSIZE);
+  uint32_t _endAddr = (startAddr + size) - ((startAddr + size) % TL_SECTORSIZE);
+  _numSectors = (_endAddr > _startAddr) ? (_endAddr - _startAddr) / TL_SECTORSIZE : 0;
+  _recordSize = recordSize;
+  _stride = sizeof(uint32_t) + recordSize;
+  _perSector = (TL_SECTORSIZE - TL_HEADERSIZE) / _stride;
+  _empty = true;
+  _oldest = _used = _headCount = 0;
+  _headSeq = _lastTime = 0;
+  _qPos = _qIndex = _qCount = _bufFirst = _bufCount = 0;
+}
+
+// Finds the oldest and the newest sector of the log already stored in the region and the number of records
+// in the newest sector - all with binary searches. Fills in the summary array if there is one.
+// Must be called before the first append.
+bool FlashTimeLog::begin() {
+  if (!_flash->getCapacity() || _numSectors < 2 || !_perSector || _stride > TL_READBUFFER) {
+    return false;
+  }
+  if (_summary) {
+    for (uint16_t s = 0; s < _numSectors; s++) {
+      _readHeader(s);
+      _summary[s] = (_hdr.seq == TL_BLANK) ? TL_BLANK : _hdr.first;
+    }
+  }
+
+  // The sequence numbers go up from one sector to the next until the ring wraps around. A blank sector
+  // reads as the highest sequence number, so the oldest sector is the one holding the lowest.
+  uint16_t _lo = 0, _hi = _numSectors - 1;
+  while (_lo < _hi) {
+    uint16_t _mid = (_lo + _hi) / 2;
+    if (_sectorSeq(_mid) > _sectorSeq(_hi)) {
+      _lo = _mid + 1;
+    }
+    else {
+      _hi = _mid;
+    }
+  }
+  _oldest = _lo;
+
+  // Counting on from the oldest sector, the sectors in use come before any blank ones
+  _lo = 0;
+  _hi = _numSectors;
+  while (_lo < _hi) {
+    uint16_t _mid = (_lo + _hi) / 2;
+    if (_sectorSeq(_ring(_mid)) == TL_BLANK) {
+      _hi = _mid;
+    }
+    else {
+      _lo = _mid + 1;
+    }
+  }
+  _used = _lo;
+  _empty = (_used == 0);
+  _bufCount = 0;
+  _qPos = _used;
+  if (_empty) {
+    _oldest = 0;
+    _headCount = 0;
+    return true;
+  }
+
+  uint16_t _head = _ring(_used - 1);
+  _headCount = _sectorCount(_head);
+  _headSeq = _hdr.seq;
+  _lastTime = _recordTime(_head, _headCount - 1);
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the position of a sector in the region, counting on from the oldest sector
+uint16_t FlashTimeLog::_ring(uint16_t pos) {
+  return (_oldest + pos) % _numSectors;
+}
+
+uint32_t FlashTimeLog::_sectorAddr(uint16_t sector) {
+  return _startAddr + (uint32_t)sector * TL_SECTORSIZE;
+}
+
+uint32_t FlashTimeLog::_recordAddr(uint16_t sector, uint16_t index) {
+  return _sectorAddr(sector) + TL_HEADERSIZE + (uint32_t)index * _stride;
+}
+
+// Reads the header of a sector into _hdr
+bool FlashTimeLog::_readHeader(uint16_t sector) {
+  if (!_flash->readByteArray(_sectorAddr(sector), (uint8_t*)&_hdr, sizeof(_hdr))) {
+    _hdr.seq = TL_BLANK;
+    return false;
+  }
+  return true;
+}
+
+uint32_t FlashTimeLog::_sectorSeq(uint16_t sector) {
+  uint32_t _seq;
+  if (!_flash->readByteArray(_sectorAddr(sector), (uint8_t*)&_seq, sizeof(_seq))) {
+    return TL_BLANK;
+  }
+  return _seq;
+}
+
+// Returns the timestamp of the first record in a sector - from the summary array if there is one
+uint32_t FlashTimeLog::_sectorFirst(uint16_t sector) {
+  if (_summary) {
+    return _summary[sector];
+  }
+  uint32_t _first;
+  if (!_flash->readByteArray(_sectorAddr(sector) + sizeof(uint32_t), (uint8_t*)&_first, sizeof(_first))) {
+    return TL_BLANK;
+  }
+  return _first;
+}
+
+uint32_t FlashTimeLog::_recordTime(uint16_t sector, uint16_t index) {
+  uint32_t _time;
+  if (!_flash->readByteArray(_recordAddr(sector, index), (uint8_t*)&_time, sizeof(_time))) {
+    return TL_BLANK;
+  }
+  return _time;
+}
+
+// Returns the number of records in a sector. The count is only stored in the header once the sector is full -
+// until then the end of the sector is found with a binary search for the first blank record.
+uint16_t FlashTimeLog::_sectorCount(uint16_t sector) {
+  _readHeader(sector);
+  if (_hdr.seq == TL_BLANK) {
+    return 0;
+  }
+  if (_hdr.count != 0xFFFF) {
+    return _hdr.count;
+  }
+  uint16_t _lo = 1, _hi = _perSector;
+  while (_lo < _hi) {
+    uint16_t _mid = (_lo + _hi) / 2;
+    if (_recordTime(sector, _mid) == TL_BLANK) {
+      _hi = _mid;
+    }
+    else {
+      _lo = _mid + 1;
+    }
+  }
+  return _lo;
+}
+
+// Checks if a sector is erased. A power loss while its first page was being programmed can leave a
+// sector that has a blank header but is not blank itself.
+bool FlashTimeLog::_sectorBlank(uint16_t sector) {
+  _bufCount = 0;
+  for (uint16_t i = 0; i < TL_SECTORSIZE; i += TL_READBUFFER) {
+    if (!_flash->readByteArray(_sectorAddr(sector) + i, _buf, TL_READBUFFER)) {
+      return false;
+    }
+    for (uint16_t j = 0; j < TL_READBUFFER; j++) {
+      if (_buf[j] != 0xFF) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool FlashTimeLog::_append(uint32_t time, const uint8_t *record, uint16_t size) {
+  if (size != _recordSize || time == TL_BLANK || (!_empty && time < _lastTime)) {
+    return false;
+  }
+
+  FlashIOVec _v[3];
+  uint8_t _n = 0;
+  uint32_t _open[2];
+  uint16_t _head;
+  if (_empty || _headCount == _perSector) {
+    // Move on to the next sector, reusing the oldest one once the ring is full
+    if (_used < _numSectors) {
+      _used++;
+    }
+    else {
+      _oldest = _ring(1);
+    }
+    _head = _ring(_used - 1);
+    if (!_sectorBlank(_head) && !_flash->eraseSector(_sectorAddr(_head))) {
+      return false;
+    }
+    _headSeq = _empty ? 0 : _headSeq + 1;
+    _headCount = 0;
+    if (_summary) {
+      _summary[_head] = time;
+    }
+    // The first half of the header goes out with the first record, in the same page program
+    _open[0] = _headSeq;
+    _open[1] = time;
+    _v[_n].addr = _sectorAddr(_head);
+    _v[_n].buffer = (uint8_t*)_open;
+    _v[_n++].len = sizeof(_open);
+  }
+  else {
+    _head = _ring(_used - 1);
+  }
+
+  _v[_n].addr = _recordAddr(_head, _headCount);
+  _v[_n].buffer = (uint8_t*)&time;
+  _v[_n++].len = sizeof(time);
+  _v[_n].addr = _v[_n - 1].addr + sizeof(time);
+  _v[_n].buffer = (uint8_t*)record;
+  _v[_n++].len = size;
+  if (!_flash->writev(_v, _n)) {
+    return false;
+  }
+  _empty = false;
+  _headCount++;
+  _lastTime = time;
+
+  if (_headCount == _perSector) {
+    // Seal the sector with the time of its last record and its record count
+    _hdr.last = _lastTime;
+    _hdr.count = _headCount;
+    if (!_flash->writeByteArray(_sectorAddr(_head) + offsetof(sectorHeader, last), (uint8_t*)&_hdr.last, sizeof(_hdr.last) + sizeof(_hdr.count))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FlashTimeLog::_next(uint32_t &time, uint8_t *record, uint16_t size) {
+  if (size != _recordSize) {
+    return false;
+  }
+  while (_qPos < _used) {
+    if (_qIndex >= _qCount) {
+      _qPos++;
+      _qIndex = 0;
+      _bufCount = 0;
+      if (_qPos < _used) {
+        _qCount = _sectorCount(_ring(_qPos));
+      }
+      continue;
+    }
+    if (_qIndex < _bufFirst || _qIndex >= _bufFirst + _bufCount) {
+      // Stream the sector through the buffer, as many whole records at a time as fit
+      uint16_t _n = TL_READBUFFER / _stride;
+      if (_n > _qCount - _qIndex) {
+        _n = _qCount - _qIndex;
+      }
+      if (!_flash->readByteArray(_recordAddr(_ring(_qPos), _qIndex), _buf, (uint32_t)_n * _stride)) {
+        _qPos = _used;
+        return false;
+      }
+      _bufFirst = _qIndex;
+      _bufCount = _n;
+    }
+    uint8_t *_rec = &_buf[(_qIndex - _bufFirst) * _stride];
+    memcpy(&time, _rec, sizeof(time));
+    if (time > _qTo) {
+      _qPos = _used;
+      return false;
+    }
+    _qIndex++;
+    if (time >= _qFrom) {
+      memcpy(record, _rec + sizeof(time), size);
+      return true;
+    }
+  }
+  return false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                           Query functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Starts a query for the records with timestamps from 'from' to 'to' - both included. The records are
+// then returned one at a time by next(). Returns false if no record in the log can match.
+//  Takes two arguments -
+//    1. from --> Earliest timestamp to return
+//    2. to --> Latest timestamp to return
+bool FlashTimeLog::find(uint32_t from, uint32_t to) {
+  _qFrom = from;
+  _qTo = to;
+  _qPos = _used;
+  _bufCount = 0;
+  if (_empty || from > to || from > _lastTime || to < _sectorFirst(_ring(0))) {
+    return false;
+  }
+
+  // Records with the same timestamp may straddle two sectors, so start in the last sector that begins
+  // strictly before 'from'
+  uint16_t _lo = 0, _hi = _used;
+  while (_lo < _hi) {
+    uint16_t _mid = (_lo + _hi) / 2;
+    if (_sectorFirst(_ring(_mid)) < from) {
+      _lo = _mid + 1;
+    }
+    else {
+      _hi = _mid;
+    }
+  }
+  _qPos = _lo ? _lo - 1 : 0;
+  _qCount = _sectorCount(_ring(_qPos));
+
+  // Skip the records in the first sector that come before 'from'
+  _lo = 0;
+  _hi = _qCount;
+  while (_lo < _hi) {
+    uint16_t _mid = (_lo + _hi) / 2;
+    if (_recordTime(_ring(_qPos), _mid) < from) {
+      _lo = _mid + 1;
+    }
+    else {
+      _hi = _mid;
+    }
+  }
+  _qIndex = _lo;
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                        Information functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the timestamp of the oldest record in the log
+uint32_t FlashTimeLog::firstTime() {
+  return _empty ? 0 : _sectorFirst(_ring(0));
+}
+
+// Returns the timestamp of the newest record in the log
+uint32_t FlashTimeLog::lastTime() {
+  return _empty ? 0 : _lastTime;
+}
@@ -0,0 +1,113 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHTIMELOG_H
+#define FLASHTIMELOG_H
+
+#include "SPIFlash.h"
+#include <stddef.h>
+
+#define TL_SECTORSIZE   KB(4)
+#define TL_HEADERSIZE   16
+#ifndef TL_READBUFFER
+#define TL_READBUFFER   SPI_PAGESIZE      // Records are streamed through a buffer of this size during a query
+#endif
+#define TL_BLANK        0xFFFFFFFF
+
+// Logs fixed-size records with a timestamp to a ring of 4KB sectors and finds the records between two
+// times without scanning the log. Every sector starts with a small header holding a sequence number and
+// the time of its first and last record and the number of records it holds, so a query only has to
+// binary search the sector headers and stream the matching sectors with bulk reads. When the ring is full
+// the oldest sector is erased and reused. Timestamps must not decrease from one record to the next.
+// An optional RAM summary - one uint32_t per sector - is filled in by begin() and saves the header reads
+// during the binary search.
+class FlashTimeLog {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashTimeLog(SPIFlash &flash, uint32_t startAddr, uint32_t size, uint16_t recordSize, uint32_t *summary = NULL);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin();
+  //-------------------------------- Write / Read functions -----------------------------//
+  template <class T> bool append(uint32_t time, const T& record);
+  bool     find(uint32_t from, uint32_t to);
+  template <class T> bool next(uint32_t &time, T& record);
+  //-------------------------------- Information functions ------------------------------//
+  uint32_t firstTime();
+  uint32_t lastTime();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _append(uint32_t time, const uint8_t *record, uint16_t size);
+  bool     _next(uint32_t &time, uint8_t *record, uint16_t size);
+  bool     _readHeader(uint16_t sector);
+  uint32_t _sectorSeq(uint16_t sector);
+  uint32_t _sectorFirst(uint16_t sector);
+  uint32_t _recordTime(uint16_t sector, uint16_t index);
+  uint16_t _sectorCount(uint16_t sector);
+  bool     _sectorBlank(uint16_t sector);
+  uint32_t _sectorAddr(uint16_t sector);
+  uint32_t _recordAddr(uint16_t sector, uint16_t index);
+  uint16_t _ring(uint16_t pos);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  uint32_t    *_summary;
+  uint32_t    _startAddr;
+  uint16_t    _numSectors, _recordSize, _stride, _perSector;
+  struct      sectorHeader {
+                uint32_t seq;
+                uint32_t first;
+                uint32_t last;
+                uint16_t count;
+                uint16_t reserved;
+              };
+              sectorHeader _hdr;
+  // Write frontier
+  bool        _empty;
+  uint16_t    _oldest, _used, _headCount;     // _used counts the sectors in use, starting with _oldest
+  uint32_t    _headSeq, _lastTime;
+  // Query state
+  uint32_t    _qFrom, _qTo;
+  uint16_t    _qPos, _qIndex, _qCount, _bufFirst, _bufCount;
+  uint8_t     _buf[TL_READBUFFER];
+};
+
+//--------------------------------- Public Templates ------------------------------------//
+
+// Appends a record to the log.
+// Takes two arguments -
+//  1. time --> Timestamp of the record. Must not be earlier than the timestamp of the previous record
+//  2. record --> Record to append. Must be recordSize bytes long
+template <class T> bool FlashTimeLog::append(uint32_t time, const T& record) {
+  return _append(time, (const uint8_t*)(const void*)&record, sizeof(record));
+}
+
+// Returns the next record matched by find(). Returns false once there are no more matching records.
+// Takes two arguments -
+//  1. time --> Variable to return the timestamp into
+//  2. record --> Variable to return the record into. Must be recordSize bytes long
+template <class T> bool FlashTimeLog::next(uint32_t &time, T& record) {
+  return _next(time, (uint8_t*)(void*)&record, sizeof(record));
+}
+
+#endif // FLASHTIMELOG_H
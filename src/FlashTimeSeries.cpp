@@ -0,0 +1,409 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashTimeSeries.h"
+
+#define TS_NOWINDOW     0xFF    // No float window has been set up in this page yet
+
+static uint32_t _zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t _unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static uint8_t _leadingZeros(uint32_t x) {
+  uint8_t n = 0;
+  while (!(x & 0x80000000UL)) {
+    x <<= 1;
+    n++;
+  }
+  return n;
+}
+
+static uint8_t _trailingZeros(uint32_t x) {
+  uint8_t n = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+}
+
+// Constructor
+//  Takes five arguments -
+//    1. flash --> The SPIFlash object to store the series in. begin() must have been called on it first
+//    2. startAddr --> Address of the region holding the series. Only whole pages inside the region are used
+//    3. size --> Size of the region - in number of bytes
+//    4. fields --> Array describing the fields of the records. Must stay valid while the series is in use
+//    5. numFields --> Number of fields in the array - up to TS_MAXFIELDS
+FlashTimeSeries::FlashTimeSeries(SPIFlash &flash, uint32_t startAddr, uint32_t size, const FlashTSField *fields, uint8_t numFields) {
+  _flash = &flash;
+  _fields = fields;
+  _numFields = (numFields > TS_MAXFIELDS) ? TS_MAXFIELDS : numFields;
+  _startAddr = (startAddr + SPI_PAGESIZE - 1) - ((startAddr + SPI_PAGESIZE - 1) % SPI_PAGESIZE);
+  _endAddr = (startAddr + size) - ((startAddr + size) % SPI_PAGESIZE);
+  if (_endAddr < _startAddr) {
+    _endAddr = _startAddr;
+  }
+  _maxBits = 4 + 32;
+  for (uint8_t i = 0; i < _numFields; i++) {
+    _maxBits += (_fields[i].type == _FLOAT_) ? 2 + 5 + 5 + 32 : 3 + 8 * _width(_fields[i].type);
+  }
+  _wPage = _startAddr;
+  _wCount = 0;
+  _wBit = TS_PAGEHEADER * 8;
+  memset(_wBuf, 0, sizeof(_wBuf));
+  rewind();
+}
+
+// Finds the end of the series already stored in the region with a binary search over the page headers.
+// Must be called before the first append.
+bool FlashTimeSeries::begin() {
+  uint32_t _lo = 0, _hi = (_endAddr - _startAddr) / SPI_PAGESIZE;
+  while (_lo < _hi) {
+    uint32_t _mid = (_lo + _hi) / 2;
+    uint16_t _count;
+    if (!_flash->readByteArray(_startAddr + _mid * SPI_PAGESIZE, (uint8_t*)&_count, sizeof(_count))) {
+      return false;
+    }
+    if (_count == 0xFFFF) {
+      _hi = _mid;
+    }
+    else {
+      _lo = _mid + 1;
+    }
+  }
+  _wPage = _startAddr + _lo * SPI_PAGESIZE;
+  _wCount = 0;
+  _wBit = TS_PAGEHEADER * 8;
+  memset(_wBuf, 0, sizeof(_wBuf));
+  rewind();
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the size of a field type - in number of bytes
+uint8_t FlashTimeSeries::_width(uint8_t type) {
+  switch (type) {
+    case _BYTE_:
+    case _CHAR_:
+    return 1;
+
+    case _WORD_:
+    case _SHORT_:
+    return 2;
+
+    default:
+    return 4;
+  }
+}
+
+// Appends the lowest 'bits' bits of value to the bit stream, most significant bit first
+void FlashTimeSeries::_putBits(uint32_t value, uint8_t bits) {
+  while (bits) {
+    uint8_t _free = 8 - (_bitPos & 7);
+    uint8_t _take = (bits < _free) ? bits : _free;
+    uint8_t _chunk = (value >> (bits - _take)) & ((1 << _take) - 1);
+    _bits[_bitPos >> 3] |= _chunk << (_free - _take);
+    _bitPos += _take;
+    bits -= _take;
+  }
+}
+
+// Takes the next 'bits' bits from the bit stream
+uint32_t FlashTimeSeries::_getBits(uint8_t bits) {
+  uint32_t _value = 0;
+  while (bits) {
+    uint8_t _left = 8 - (_bitPos & 7);
+    uint8_t _take = (bits < _left) ? bits : _left;
+    uint8_t _chunk = (_bits[_bitPos >> 3] >> (_left - _take)) & ((1 << _take) - 1);
+    _value = (_value << _take) | _chunk;
+    _bitPos += _take;
+    bits -= _take;
+  }
+  return _value;
+}
+
+// Timestamps are stored as the change in the interval between samples:
+//  0           --> Same interval as before
+//  10   + 7b   --> Change fits in 7 bits (zigzag encoded)
+//  110  + 9b   --> Change fits in 9 bits
+//  1110 + 12b  --> Change fits in 12 bits
+//  1111 + 32b  --> Any other change
+void FlashTimeSeries::_putTime(uint32_t time, bool first) {
+  if (first) {
+    _putBits(time, 32);
+    _s->delta = 0;
+  }
+  else {
+    int32_t _delta = time - _s->time;
+    uint32_t _zz = _zigzag(_delta - _s->delta);
+    if (!_zz) {
+      _putBits(0x00, 1);
+    }
+    else if (_zz < (1UL << 7)) {
+      _putBits(0x02, 2);
+      _putBits(_zz, 7);
+    }
+    else if (_zz < (1UL << 9)) {
+      _putBits(0x06, 3);
+      _putBits(_zz, 9);
+    }
+    else if (_zz < (1UL << 12)) {
+      _putBits(0x0E, 4);
+      _putBits(_zz, 12);
+    }
+    else {
+      _putBits(0x0F, 4);
+      _putBits(_zz, 32);
+    }
+    _s->delta = _delta;
+  }
+  _s->time = time;
+}
+
+uint32_t FlashTimeSeries::_getTime(bool first) {
+  if (first) {
+    _s->time = _getBits(32);
+    _s->delta = 0;
+    return _s->time;
+  }
+  uint32_t _zz = 0;
+  if (_getBits(1)) {
+    if (!_getBits(1)) {
+      _zz = _getBits(7);
+    }
+    else if (!_getBits(1)) {
+      _zz = _getBits(9);
+    }
+    else if (!_getBits(1)) {
+      _zz = _getBits(12);
+    }
+    else {
+      _zz = _getBits(32);
+    }
+  }
+  _s->delta += _unzigzag(_zz);
+  _s->time += _s->delta;
+  return _s->time;
+}
+
+// Integer fields are stored as the change from the previous sample:
+//  0          --> Unchanged
+//  10  + 6b   --> Change fits in 6 bits (zigzag encoded)
+//  110 + 13b  --> Change fits in 13 bits
+//  111 + raw  --> The new value in full
+// Float fields are XORed with the previous value:
+//  0                            --> Unchanged
+//  10 + bits                    --> The bits that differ fit in the current window
+//  11 + 5b lead + 5b len + bits --> New window of len+1 bits, lead bits from the top
+void FlashTimeSeries::_putField(uint8_t i, uint32_t value, bool first) {
+  uint8_t _type = _fields[i].type;
+  if (first) {
+    _putBits(value, 8 * _width(_type));
+    _s->lead[i] = TS_NOWINDOW;
+  }
+  else if (_type == _FLOAT_) {
+    uint32_t _x = value ^ _s->value[i];
+    if (!_x) {
+      _putBits(0x00, 1);
+    }
+    else {
+      uint8_t _lead = _leadingZeros(_x);
+      uint8_t _trail = _trailingZeros(_x);
+      if (_s->lead[i] != TS_NOWINDOW && _lead >= _s->lead[i] && _trail >= _s->trail[i]) {
+        _putBits(0x02, 2);
+        _putBits(_x >> _s->trail[i], 32 - _s->lead[i] - _s->trail[i]);
+      }
+      else {
+        _putBits(0x03, 2);
+        _putBits(_lead, 5);
+        _putBits(31 - _lead - _trail, 5);
+        _putBits(_x >> _trail, 32 - _lead - _trail);
+        _s->lead[i] = _lead;
+        _s->trail[i] = _trail;
+      }
+    }
+  }
+  else {
+    uint32_t _zz = _zigzag(value - _s->value[i]);
+    if (!_zz) {
+      _putBits(0x00, 1);
+    }
+    else if (_zz < (1UL << 6)) {
+      _putBits(0x02, 2);
+      _putBits(_zz, 6);
+    }
+    else if (_zz < (1UL << 13)) {
+      _putBits(0x06, 3);
+      _putBits(_zz, 13);
+    }
+    else {
+      _putBits(0x07, 3);
+      _putBits(value, 8 * _width(_type));
+    }
+  }
+  _s->value[i] = value;
+}
+
+uint32_t FlashTimeSeries::_getField(uint8_t i, bool first) {
+  uint8_t _type = _fields[i].type;
+  if (first) {
+    _s->value[i] = _getBits(8 * _width(_type));
+    _s->lead[i] = TS_NOWINDOW;
+  }
+  else if (_type == _FLOAT_) {
+    if (_getBits(1)) {
+      if (_getBits(1)) {
+        _s->lead[i] = _getBits(5);
+        _s->trail[i] = 32 - _s->lead[i] - (_getBits(5) + 1);
+      }
+      _s->value[i] ^= _getBits(32 - _s->lead[i] - _s->trail[i]) << _s->trail[i];
+    }
+  }
+  else if (_getBits(1)) {
+    if (!_getBits(1)) {
+      _s->value[i] += _unzigzag(_getBits(6));
+    }
+    else if (!_getBits(1)) {
+      _s->value[i] += _unzigzag(_getBits(13));
+    }
+    else {
+      _s->value[i] = _getBits(8 * _width(_type));
+    }
+  }
+  return _s->value[i];
+}
+
+// Programs the page being filled, with the number of samples it holds in its header, and starts a new page
+bool FlashTimeSeries::_sealPage() {
+  if (!_wCount) {
+    return true;
+  }
+  _wBuf[0] = _wCount & 0xFF;
+  _wBuf[1] = _wCount >> 8;
+  if (!_flash->writeByteArray(_wPage, _wBuf, (_wBit + 7) / 8)) {
+    return false;
+  }
+  _wPage += SPI_PAGESIZE;
+  _wCount = 0;
+  _wBit = TS_PAGEHEADER * 8;
+  memset(_wBuf, 0, sizeof(_wBuf));
+  return true;
+}
+
+bool FlashTimeSeries::_append(uint32_t time, const uint8_t *record) {
+  if (_wBit + _maxBits > SPI_PAGESIZE * 8 && !_sealPage()) {
+    return false;
+  }
+  if (_wPage >= _endAddr) {
+    return false;
+  }
+  _s = &_w;
+  _bits = _wBuf;
+  _bitPos = _wBit;
+  _putTime(time, !_wCount);
+  for (uint8_t i = 0; i < _numFields; i++) {
+    uint32_t _value = 0;
+    memcpy(&_value, &record[_fields[i].offset], _width(_fields[i].type));
+    _putField(i, _value, !_wCount);
+  }
+  _wBit = _bitPos;
+  _wCount++;
+  return true;
+}
+
+bool FlashTimeSeries::_read(uint32_t &time, uint8_t *record) {
+  uint8_t *_data;
+  while (true) {
+    if (_rPage == _wPage) {
+      // Reading the page that is still being filled - take it straight from the write buffer
+      if (_rIndex >= _wCount) {
+        return false;
+      }
+      _data = _wBuf;
+      break;
+    }
+    if (!_rCount) {
+      if (!_flash->readByteArray(_rPage, _rBuf, SPI_PAGESIZE)) {
+        return false;
+      }
+      _rCount = _rBuf[0] | (_rBuf[1] << 8);
+      if (_rCount == 0xFFFF) {
+        _rCount = 0;
+        return false;
+      }
+    }
+    if (_rIndex < _rCount) {
+      _data = _rBuf;
+      break;
+    }
+    _rPage += SPI_PAGESIZE;
+    _rCount = _rIndex = 0;
+    _rBit = TS_PAGEHEADER * 8;
+  }
+
+  _s = &_r;
+  _bits = _data;
+  _bitPos = _rBit;
+  time = _getTime(!_rIndex);
+  for (uint8_t i = 0; i < _numFields; i++) {
+    uint32_t _value = _getField(i, !_rIndex);
+    memcpy(&record[_fields[i].offset], &_value, _width(_fields[i].type));
+  }
+  _rBit = _bitPos;
+  _rIndex++;
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                       Write / Read functions                       //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Programs the page being filled. The next sample starts a new page, so call this sparingly -
+// for example before powering down.
+bool FlashTimeSeries::flush() {
+  return _sealPage();
+}
+
+// Moves the reader back to the oldest sample
+void FlashTimeSeries::rewind() {
+  _rPage = _startAddr;
+  _rCount = _rIndex = 0;
+  _rBit = TS_PAGEHEADER * 8;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                       Information functions                        //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the number of bytes of the region taken up by the series, including the page being filled
+uint32_t FlashTimeSeries::used() {
+  return (_wPage - _startAddr) + (_wCount ? (_wBit + 7) / 8 : 0);
+}
@@ -0,0 +1,120 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHTIMESERIES_H
+#define FLASHTIMESERIES_H
+
+#include "SPIFlash.h"
+#include <stddef.h>
+
+#ifndef TS_MAXFIELDS
+#define TS_MAXFIELDS    8
+#endif
+#define TS_PAGEHEADER   2       // Each page starts with the number of samples it holds
+
+// Describes one field of the records in a time series. type is one of the supported data types
+// in defines.h - _BYTE_, _CHAR_, _WORD_, _SHORT_, _ULONG_, _LONG_ or _FLOAT_
+struct FlashTSField {
+  uint8_t offset;
+  uint8_t type;
+};
+#define TSFIELD(record, member, type) { offsetof(record, member), type }
+
+// Stores timestamped fixed-layout records in a compact bit stream, page by page.
+// Timestamps are stored as delta-of-deltas and integer fields as deltas, each with a variable length code that
+// takes a single bit when nothing has changed. Float fields are XORed with the previous value and only the bits
+// that differ are stored. The first sample in every page is stored in full, so every page decodes on its own.
+// A page is programmed once it cannot hold another sample, or when flush() is called.
+// WARNING: The region must be erased before it is first used (see eraseSection()).
+class FlashTimeSeries {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashTimeSeries(SPIFlash &flash, uint32_t startAddr, uint32_t size, const FlashTSField *fields, uint8_t numFields);
+  //----------------------------------- Initial functions -------------------------------//
+  bool     begin();
+  //-------------------------------- Write / Read functions -----------------------------//
+  template <class T> bool append(uint32_t time, const T& record);
+  template <class T> bool read(uint32_t &time, T& record);
+  bool     flush();
+  void     rewind();
+  //-------------------------------- Information functions ------------------------------//
+  uint32_t used();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _append(uint32_t time, const uint8_t *record);
+  bool     _read(uint32_t &time, uint8_t *record);
+  bool     _sealPage();
+  void     _putBits(uint32_t value, uint8_t bits);
+  uint32_t _getBits(uint8_t bits);
+  void     _putTime(uint32_t time, bool first);
+  uint32_t _getTime(bool first);
+  void     _putField(uint8_t i, uint32_t value, bool first);
+  uint32_t _getField(uint8_t i, bool first);
+  uint8_t  _width(uint8_t type);
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  const FlashTSField *_fields;
+  uint8_t     _numFields;
+  uint16_t    _maxBits;                       // Worst case size of one sample
+  uint32_t    _startAddr, _endAddr;
+  // Encoder / decoder state - the writer and the reader take turns using it
+  struct      seriesState {
+                uint32_t time;
+                int32_t  delta;
+                uint32_t value[TS_MAXFIELDS];
+                uint8_t  lead[TS_MAXFIELDS], trail[TS_MAXFIELDS];
+              };
+              seriesState _w, _r, *_s;
+  uint8_t     *_bits;
+  uint16_t    _bitPos;
+  // Writer
+  uint32_t    _wPage;
+  uint16_t    _wCount, _wBit;
+  uint8_t     _wBuf[SPI_PAGESIZE];
+  // Reader
+  uint32_t    _rPage;
+  uint16_t    _rCount, _rIndex, _rBit;
+  uint8_t     _rBuf[SPI_PAGESIZE];
+};
+
+//--------------------------------- Public Templates ------------------------------------//
+
+// Appends a record to the series.
+// Takes two arguments -
+//  1. time --> Timestamp of the record. Any unit can be used, as long as it is used consistently
+//  2. record --> Record to append. Its layout must match the fields passed to the constructor
+template <class T> bool FlashTimeSeries::append(uint32_t time, const T& record) {
+  return _append(time, (const uint8_t*)(const void*)&record);
+}
+
+// Reads the next record in the series, starting with the oldest. Returns false when there are no more records.
+// Takes two arguments -
+//  1. time --> Variable to return the timestamp into
+//  2. record --> Variable to return the record into. Only the fields passed to the constructor are filled in
+template <class T> bool FlashTimeSeries::read(uint32_t &time, T& record) {
+  return _read(time, (uint8_t*)(void*)&record);
+}
+
+#endif // FLASHTIMESERIES_H
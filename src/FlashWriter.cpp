@@ -0,0 +1,153 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlashWriter.h"
+
+// Constructor
+//  Takes four arguments -
+//    1. flash --> The SPIFlash object to write to. begin() must have been called on it before the first write
+//    2. startAddr --> Address of the first byte to be appended
+//    3. size --> Size of the region available to the writer - in number of bytes
+//    4. errorCheck --> Turned on by default. Checks every page program for writing errors
+FlashWriter::FlashWriter(SPIFlash &flash, uint32_t startAddr, uint32_t size, bool errorCheck) {
+  _flash = &flash;
+  _errorCheck = errorCheck;
+  _endAddr = startAddr + size;
+  _pageAddr = startAddr - (startAddr % SPI_PAGESIZE);
+  // The bytes between the start of the page and startAddr do not belong to the writer - treat them as already programmed
+  _fill = _flushed = startAddr - _pageAddr;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                         Private functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Programs the bytes in the page buffer that have not been written to the flash yet. Once the
+// buffer holds a full page (or reaches the end of the region) the writer moves on to the next page.
+bool FlashWriter::_program() {
+  if (_fill > _flushed) {
+    if (!_flash->writeByteArray(_pageAddr + _flushed, &_buf[_flushed], _fill - _flushed, _errorCheck)) {
+      setWriteError();
+      return false;
+    }
+    _flushed = _fill;
+  }
+  if (_fill == SPI_PAGESIZE) {
+    _pageAddr += SPI_PAGESIZE;
+    _fill = _flushed = 0;
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                          Print functions                           //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Appends a single byte. Returns 1 if the byte was accepted, 0 if the region is full or a page program failed.
+size_t FlashWriter::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+// Appends an array of bytes. Full pages are programmed as soon as they fill up.
+// Returns the number of bytes accepted.
+size_t FlashWriter::write(const uint8_t *buffer, size_t size) {
+  size_t _written = 0;
+  while (_written < size) {
+    uint32_t _addr = _pageAddr + _fill;
+    if (_addr >= _endAddr) {
+      setWriteError();
+      break;
+    }
+    uint32_t _chunk = SPI_PAGESIZE - _fill;
+    if (_chunk > _endAddr - _addr) {
+      _chunk = _endAddr - _addr;
+    }
+    if (_chunk > size - _written) {
+      _chunk = size - _written;
+    }
+    memcpy(&_buf[_fill], &buffer[_written], _chunk);
+    _fill += _chunk;
+    _written += _chunk;
+
+    if (_fill == SPI_PAGESIZE || _pageAddr + _fill == _endAddr) {
+      if (!_program()) {
+        break;
+      }
+    }
+  }
+  return _written;
+}
+
+// Programs any buffered bytes that make up a partial page. Appending may continue afterwards -
+// the rest of the page is programmed later without rewriting the bytes already in the flash.
+void FlashWriter::flush() {
+  _program();
+}
+
+// Reads data back from the flash memory, taking any bytes that are still waiting in the page buffer from RAM.
+//  Takes three arguments -
+//    1. addr --> Any address from 0 to capacity
+//    2. buffer --> Buffer to read the data into
+//    3. size --> Number of bytes to read
+bool FlashWriter::read(uint32_t addr, void *buffer, size_t size) {
+  uint8_t *_out = (uint8_t*)buffer;
+  uint32_t _bufStart = _pageAddr + _flushed;
+  uint32_t _bufEnd = _pageAddr + _fill;
+  uint32_t _chunk;
+
+  if (size && addr < _bufStart) {
+    _chunk = (size < _bufStart - addr) ? size : _bufStart - addr;
+    if (!_flash->readByteArray(addr, _out, _chunk)) {
+      return false;
+    }
+    _out += _chunk;
+    addr += _chunk;
+    size -= _chunk;
+  }
+  if (size && addr < _bufEnd) {
+    _chunk = (size < _bufEnd - addr) ? size : _bufEnd - addr;
+    memcpy(_out, &_buf[addr - _pageAddr], _chunk);
+    _out += _chunk;
+    addr += _chunk;
+    size -= _chunk;
+  }
+  if (size) {
+    return _flash->readByteArray(addr, _out, size);
+  }
+  return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//                          Offset functions                          //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Returns the address the next byte will be appended at
+uint32_t FlashWriter::position() {
+  return _pageAddr + _fill;
+}
+
+// Returns the number of bytes that can still be appended before the end of the region
+uint32_t FlashWriter::remaining() {
+  return _endAddr - (_pageAddr + _fill);
+}
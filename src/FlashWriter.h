@@ -0,0 +1,60 @@
+/* Arduino SPIFlash Library v.3.1.0
+ * Copyright (C) 2017 by Prajwal Bhattaram
+ *
+ * This file is part of the Arduino SPIFlash Library. This library is for
+ * Winbond NOR flash memory modules. In its current form it enables reading
+ * and writing individual data variables, structs and arrays from and to various locations;
+ * reading and writing pages; continuous read functions; sector, block and chip erase;
+ * suspending and resuming programming/erase and powering down for low power operation.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License v3.0
+ * along with the Arduino SPIFlash Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASHWRITER_H
+#define FLASHWRITER_H
+
+#include "SPIFlash.h"
+
+// Appends a stream of bytes to a region of the flash memory. Anything that can be printed
+// with Serial.print() can be printed to a FlashWriter. Output is collected in a page sized
+// buffer and each page is programmed once it is full, so no heap is used and the flash sees
+// one page program per 256 bytes instead of one per print() call.
+// WARNING: The region being written to must be erased beforehand (see eraseSector()/eraseSection()).
+class FlashWriter : public Print {
+public:
+  //------------------------------------ Constructor ------------------------------------//
+  FlashWriter(SPIFlash &flash, uint32_t startAddr, uint32_t size, bool errorCheck = true);
+  //----------------------------------- Print functions ---------------------------------//
+  size_t   write(uint8_t data);
+  size_t   write(const uint8_t *buffer, size_t size);
+  using    Print::write;
+  void     flush();
+  bool     read(uint32_t addr, void *buffer, size_t size);
+  //---------------------------------- Offset functions ---------------------------------//
+  uint32_t position();
+  uint32_t remaining();
+
+private:
+  //------------------------------- Private functions -----------------------------------//
+  bool     _program();
+  //-------------------------------- Private variables ----------------------------------//
+  SPIFlash    *_flash;
+  bool        _errorCheck;
+  uint32_t    _pageAddr, _endAddr;
+  uint16_t    _fill, _flushed;
+  uint8_t     _buf[SPI_PAGESIZE];
+};
+
+#endif // FLASHWRITER_H
@@ -27,6 +27,18 @@
 
 #include "SPIFlash.h"
 
+#ifdef ENABLETRACE
+// Prints the lowest 'bytes' bytes of value as hex, least significant byte first
+static void _printHexLE(Print &out, uint32_t value, uint8_t bytes) {
+  const char _digits[] = "0123456789ABCDEF";
+  for (uint8_t i = 0; i < bytes; i++) {
+    out.print(_digits[(value >> 4) & 0x0F]);
+    out.print(_digits[value & 0x0F]);
+    value >>= 8;
+  }
+}
+#endif
+
 // Constructor
 //If board has multiple SPI interfaces, this constructor lets the user choose between them
 SPIFlash::SPIFlash(uint8_t cs) {
@@ -35,60 +47,249 @@ SPIFlash::SPIFlash(uint8_t cs) {
   CHIP_DESELECT
 }
 
+// Starts timing a public function. Nested calls only set the operation type their SPI transactions are counted under.
+//  Takes three arguments -
+//    1. flash --> The SPIFlash object the function was called on
+//    2. type --> STATS_READ, STATS_WRITE, STATS_ERASE or STATS_CONTROL
+//    3. bytes --> Number of bytes the function reads, writes or erases
+FlashOpScope::FlashOpScope(SPIFlash *flash, uint8_t type, uint32_t bytes) {
+  _flash = flash;
+  _type = type;
+  this->bytes = bytes;
+  _outer = (_flash->_statsDepth++ == 0);
+  _start = micros();
+#if defined (ENABLESTATS) || defined (ENABLETRACE)
+  _prevOp = _flash->_curOp;
+  if (_outer) {
+    _flash->_curOp = type;
+  }
+#endif
+#ifdef ENABLESTATS
+  _errors = _flash->_statsErrors;
+#endif
+}
+
+// Stops timing when the function returns and records the result
+FlashOpScope::~FlashOpScope() {
+  _flash->_statsDepth--;
+  if (!_outer) {
+    return;
+  }
+  uint32_t _elapsed = micros() - _start;
+  _flash->_spifuncruntime = _elapsed;
+#ifdef ENABLESTATS
+  FlashOpStats &_op = _flash->_stats.op[_type];
+  uint8_t _bin = 0;
+  while (_bin < STATS_HISTBINS - 1 && (_elapsed >> _bin)) {
+    _bin++;
+  }
+  _op.calls++;
+  _op.bytes += bytes;
+  _op.totalTime += _elapsed;
+  if (_elapsed < _op.minTime) {
+    _op.minTime = _elapsed;
+  }
+  if (_elapsed > _op.maxTime) {
+    _op.maxTime = _elapsed;
+  }
+  _op.histogram[_bin]++;
+  if (_flash->_statsErrors != _errors) {
+    _op.errors++;
+  }
+#endif
+#if defined (ENABLESTATS) || defined (ENABLETRACE)
+  _flash->_curOp = _prevOp;
+#endif
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 //     Public functions used for read, write and erase operations     //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 
 //Identifies chip and establishes parameters
 bool SPIFlash::begin(uint32_t flashChipSize) {
-#ifdef RUNDIAGNOSTIC
+#ifdef ENABLESTATS
+  resetStats();
+#endif
+#if FLASHLOGLEVEL >= FLASHLOG_ERROR
+  clearErrors();
+#endif
+#if FLASHLOGLEVEL >= FLASHLOG_INFO
   Serial.println("Chip Diagnostics initiated.");
   Serial.println();
-#endif
 #ifdef HIGHSPEED
   Serial.println("Highspeed mode initiated.");
   Serial.println();
+#endif
 #endif
   SPI.begin();
 #ifdef SPI_HAS_TRANSACTION
   //Define the settings to be used by the SPI bus
-  _settings = SPISettings(SPI_CLK, MSBFIRST, SPI_MODE0);
+  setClock(SPI_CLK);
 #endif
+  bool retVal = true;
 // If no capacity is defined in user code
   if (!flashChipSize) {
-    #ifdef RUNDIAGNOSTIC
+    #if FLASHLOGLEVEL >= FLASHLOG_INFO
     Serial.println("No Chip size defined by user. Automated identification initiated.");
     #endif
-    bool retVal = _chipID();
-    _endSPI();
-    return retVal;
+    retVal = _chipID();
+    if (retVal) {
+      _getSFDPTimes();
+    }
   }
   else {
     _getJedecId();
     // If a custom chip size is defined
-    #ifdef RUNDIAGNOSTIC
+    #if FLASHLOGLEVEL >= FLASHLOG_INFO
     Serial.println("Custom Chipsize defined");
     #endif
     _chip.capacity = flashChipSize;
     _chip.supported = false;
+    _getSFDPTimes();
   }
   _endSPI();
 
-  if (_chip.manufacturerID == CYPRESS_MANID) {
-    setClock(SPI_CLK/4);    // Cypress/Spansion chips appear to perform best at SPI_CLK/4
+  // Chips identified automatically stay at SPI_CLK, as they always have - see calibrate() for a faster or slower clock
+  #ifdef SPI_HAS_TRANSACTION
+  if (flashChipSize && _chip.manufacturerID == CYPRESS_MANID) {
+    setClock(SPI_CLK/4);    // Cypress/Spansion chips appear to perform best at SPI_CLK/4 - calibrate() finds their real limit
   }
+  #endif
   chipPoweredDown = false;
-  return true;
+  return retVal;
 }
 
 //Allows the setting of a custom clock speed for the SPI bus to communicate with the chip.
+//Sets the clock for fast reads as well - see setFastReadClock().
 //Only works if the SPI library in use supports SPI Transactions
 #ifdef SPI_HAS_TRANSACTION
 void SPIFlash::setClock(uint32_t clockSpeed) {
   _settings = SPISettings(clockSpeed, MSBFIRST, SPI_MODE0);
+  _clock = clockSpeed;
+  _jobCost = 0;
+  setFastReadClock(clockSpeed);
+}
+
+//Sets the clock speed used by fast reads (JEDEC_READ_FAST) only. Most chips can run fast reads much faster than normal
+//reads, which have no dummy byte, and than the other commands. Call it after setClock().
+//Only works if the SPI library in use supports SPI Transactions
+void SPIFlash::setFastReadClock(uint32_t clockSpeed) {
+  _fastSettings = SPISettings(clockSpeed, MSBFIRST, SPI_MODE0);
+  _fastClock = clockSpeed;
+}
+
+//Finds the highest clock speeds the chip and the board can run at, for fast reads and for every other command, and
+//switches to them. A test pattern is written to a scratch sector at the clocks in use and read back at rising clocks -
+//with fast reads for the fast read clock and with normal reads, after the JEDEC ID, for the other clock. Each clock is
+//raised by 1/CALIBRATE_STEP at a time until the pattern no longer reads back correctly or maxClock is reached, and
+//CALIBRATE_MARGIN percent is then taken off the highest clock that passed. Clocks above maxClock are lowered to it
+//first. Finally the pattern is written again at the new clock and checked. The scratch sector is left erased.
+//Returns false - leaving the clocks as they were - if the pattern cannot be written and read back.
+//Only works if the SPI library in use supports SPI Transactions
+//  Takes two arguments -
+//    1. scratchAddr --> Any address in a 4 KB sector whose contents may be destroyed
+//    2. maxClock --> Highest clock to try - in Hz. Defaults to CALIBRATE_MAXCLK
+bool SPIFlash::calibrate(uint32_t scratchAddr, uint32_t maxClock) {
+  FLASH_OP(STATS_CONTROL, 0)
+  uint32_t _addr = scratchAddr - (scratchAddr % KB(4));
+  uint32_t _oldClock = _clock, _oldFastClock = _fastClock;
+  if (_clock > maxClock) {
+    setClock(maxClock);
+  }
+  if (_fastClock > maxClock) {
+    setFastReadClock(maxClock);
+  }
+  uint32_t _startClock = _clock, _startFastClock = _fastClock;
+  if (!_calWrite(_addr) || !_calCheck(_addr, JEDEC_READ_DATA, _clock) || !_calCheck(_addr, JEDEC_READ_FAST, _fastClock)) {
+    setClock(_oldClock);
+    setFastReadClock(_oldFastClock);
+    _troubleshoot(CALIBRATIONFAIL);
+    return false;
+  }
+
+  uint32_t _cmd = _clock, _fast = _fastClock;
+  bool _cmdRising = true, _fastRising = true;
+  while (_cmdRising || _fastRising) {
+    if (_cmdRising) {
+      uint32_t _next = _cmd + _cmd / CALIBRATE_STEP;
+      _cmdRising = (_next <= maxClock) && _calCheck(_addr, JEDEC_READ_DATA, _next);
+      if (_cmdRising) {
+        _cmd = _next;
+      }
+    }
+    if (_fastRising) {
+      uint32_t _next = _fast + _fast / CALIBRATE_STEP;
+      _fastRising = (_next <= maxClock) && _calCheck(_addr, JEDEC_READ_FAST, _next);
+      if (_fastRising) {
+        _fast = _next;
+      }
+    }
+  }
+  // Back off from the edge - but not below the clocks the pattern was written at
+  _cmd -= (_cmd / 100) * CALIBRATE_MARGIN;
+  _fast -= (_fast / 100) * CALIBRATE_MARGIN;
+  setClock((_cmd > _startClock) ? _cmd : _startClock);
+  setFastReadClock((_fast > _startFastClock) ? _fast : _startFastClock);
+
+  // Page programs run at the command clock too
+  if (!_calWrite(_addr) || !_calCheck(_addr, JEDEC_READ_DATA, _clock)) {
+    setClock(_oldClock);
+    setFastReadClock(_oldFastClock);
+    _troubleshoot(CALIBRATIONFAIL);
+    eraseSector(_addr);
+    return false;
+  }
+  return eraseSector(_addr);
 }
 #endif
 
+//Returns the SPI clock speed used by every command other than fast reads - in Hz
+uint32_t SPIFlash::getClock() {
+  return _clock;
+}
+
+//Returns the SPI clock speed used by fast reads - in Hz
+uint32_t SPIFlash::getFastReadClock() {
+  return _fastClock;
+}
+
+//Turns the check for previously written data before every write on or off. The check is on by default.
+//Turning it off speeds up writes to memory that is known to be erased and allows bits that are still 1 in a
+//byte that has been written to be cleared - NOR flash can always program a 1 to a 0 without an erase.
+//The check is never made if HIGHSPEED is defined.
+void SPIFlash::setBlankCheck(bool enabled) {
+  blankCheckEnabled = enabled;
+}
+
+//Returns true if the check for previously written data before every write is on - see setBlankCheck()
+bool SPIFlash::getBlankCheck() {
+  return blankCheckEnabled;
+}
+
+//Sets how long a call to poll() or to one of the asynchronous erase / write functions may spend on the job in progress.
+//Within the budget the job is split into page programs and erase commands, and the call waits for each one that is
+//expected to complete before the budget runs out. Once the next wait would overrun the budget the call returns, leaving
+//the rest of the job in its FlashJob for the next call to poll(). Reads issued in between suspend the erase or program
+//in progress - see setSuspendBudget().
+//A command is only issued if the longest step seen so far - a page program with its blank check and read back, at the
+//current clock - still fits in what is left of the budget. A budget shorter than one step is overrun by that step.
+//  Takes one argument -
+//    1. budget --> Time in uS. Defaults to 0 - each call issues at most one command and never waits for the chip
+void SPIFlash::setTimeBudget(uint32_t budget) {
+  _timeBudget = budget;
+}
+
+//Sets how long a single program or erase may be kept suspended so that reads do not have to wait for it. A read that
+//arrives while the chip is programming or erasing suspends the operation, is served and resumes it. Once an operation
+//has used up its budget, reads wait for it to complete. Chip erases are never suspended.
+//Only supported on Winbond, Cypress and SST26 parts - reads always wait on other chips.
+//  Takes one argument -
+//    1. budget --> Time in uS. Defaults to SUSPEND_BUDGET. 0 turns automatic suspend off
+void SPIFlash::setSuspendBudget(uint32_t budget) {
+  _suspendBudget = budget;
+}
+
 uint8_t SPIFlash::error(bool _verbosity) {
   if (!_verbosity) {
     return errorcode;
@@ -99,6 +300,53 @@ uint8_t SPIFlash::error(bool _verbosity) {
   }
 }
 
+#if FLASHLOGLEVEL >= FLASHLOG_ERROR
+//Returns the number of errors raised since begin() or the last call to clearErrors(). Only the last
+//ERRORLOG_DEPTH of them are kept in the error log.
+uint32_t SPIFlash::errorsLogged() {
+  return _errorCount;
+}
+
+//Copies an error from the error log
+//  Takes two arguments -
+//    1. n --> 0 for the most recent error, 1 for the one before it and so on
+//    2. event --> Structure to copy the error into
+//Returns false if the log does not hold that many errors
+bool SPIFlash::getError(uint8_t n, FlashErrorEvent &event) {
+  if (n >= ERRORLOG_DEPTH || n >= _errorCount) {
+    return false;
+  }
+  event = _errorLog[(_errorCount - 1 - n) % ERRORLOG_DEPTH];
+  return true;
+}
+
+//Empties the error log
+void SPIFlash::clearErrors() {
+  _errorCount = 0;
+}
+
+//Prints the errors in the error log, oldest first - one line each with the time, error code, opcode and address.
+//Call it from a point where the time taken to print does not matter, rather than after every call to the library.
+//  Takes one argument -
+//    1. out --> Where to print to - eg. Serial
+void SPIFlash::printErrors(Print &out) {
+  FlashErrorEvent _e;
+  uint8_t n = (_errorCount < ERRORLOG_DEPTH) ? _errorCount : ERRORLOG_DEPTH;
+  while (n--) {
+    if (!getError(n, _e)) {
+      continue;
+    }
+    out.print(_e.time);
+    out.print(" us: error 0x");
+    out.print(_e.code, HEX);
+    out.print(" after opcode 0x");
+    out.print(_e.opcode, HEX);
+    out.print(" at address 0x");
+    out.println(_e.addr, HEX);
+  }
+}
+#endif
+
 //Returns capacity of chip
 uint32_t SPIFlash::getCapacity() {
 	return _chip.capacity;
@@ -109,16 +357,126 @@ uint32_t SPIFlash::getMaxPage() {
 	return (_chip.capacity / SPI_PAGESIZE);
 }
 
+//Returns true while the chip is busy programming or erasing
+bool SPIFlash::isBusy() {
+  _readStat1();
+  _endSPI();
+  if (!(stat1 & BUSY)) {
+    _busyOp = BUSY_NONE;      // The program or erase is over - it is too late to tell how long it took
+  }
+  return stat1 & BUSY;
+}
+
 //Returns the time taken to run a function. Must be called immediately after a function is run as the variable returned is overwritten each time a function from this library is called. Primarily used in the diagnostics sketch included in the library to track function time.
-//This function can only be called if #define RUNDIAGNOSTIC is uncommented in SPIFlash.h
+//Only returns a time if FLASHLOGLEVEL is FLASHLOG_DEBUG or #define ENABLESTATS is uncommented in SPIFlash.h
+//For anything more than a one-off measurement use getStats() instead.
 float SPIFlash::functionRunTime() {
-#ifdef RUNDIAGNOSTIC
+#if (FLASHLOGLEVEL >= FLASHLOG_DEBUG) || defined (ENABLESTATS)
   return _spifuncruntime;
 #else
   return 0;
 #endif
 }
 
+#ifdef ENABLESTATS
+//Returns the statistics collected since begin() or the last call to resetStats(). The returned structure is updated in
+//place as the library is used - copy it to take a snapshot for periodic export.
+const FlashStats &SPIFlash::getStats() {
+  return _stats;
+}
+
+//Clears the statistics for all operation types
+void SPIFlash::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+  for (uint8_t i = 0; i < STATS_OPTYPES; i++) {
+    _stats.op[i].minTime = 0xFFFFFFFF;
+  }
+  _stats.since = micros();
+}
+
+//Prints the statistics as CSV - one line per operation type
+//  Takes one argument -
+//    1. out --> Where to print to - eg. Serial or a FlashWriter
+void SPIFlash::printStats(Print &out) {
+  const char *_names[STATS_OPTYPES] = {"read", "write", "erase", "control"};
+  out.print("op,calls,errors,bytes,transactions,busyPolls,busyTime,minTime,meanTime,maxTime");
+  for (uint8_t b = 0; b < STATS_HISTBINS; b++) {
+    out.print(",h");
+    out.print(b);
+  }
+  out.println();
+  for (uint8_t i = 0; i < STATS_OPTYPES; i++) {
+    const FlashOpStats &_op = _stats.op[i];
+    out.print(_names[i]);
+    out.print(',');
+    out.print(_op.calls);
+    out.print(',');
+    out.print(_op.errors);
+    out.print(',');
+    out.print(_op.bytes);
+    out.print(',');
+    out.print(_op.transactions);
+    out.print(',');
+    out.print(_op.busyPolls);
+    out.print(',');
+    out.print(_op.busyTime);
+    out.print(',');
+    out.print(_op.calls ? _op.minTime : 0);
+    out.print(',');
+    out.print(_op.calls ? _op.totalTime / _op.calls : 0);
+    out.print(',');
+    out.print(_op.maxTime);
+    for (uint8_t b = 0; b < STATS_HISTBINS; b++) {
+      out.print(',');
+      out.print(_op.histogram[b]);
+    }
+    out.println();
+  }
+}
+#endif
+
+#ifdef ENABLETRACE
+//Prints the SPI transactions in the trace ring, oldest first, for decoding with extras/host/flashtrace.
+//The dump starts with a '#FLASHTRACE' line and ends with '#END'. Every line in between is one 16 byte
+//FlashTraceEntry, written as 32 hex digits with each field least significant byte first. Anything printed
+//before or after the dump - by the sketch or the diagnostics - is ignored by the decoder.
+//  Takes one argument -
+//    1. out --> Where to print to - eg. Serial or a FlashWriter
+void SPIFlash::dumpTrace(Print &out) {
+  uint16_t _n = (_traceCount < TRACE_DEPTH) ? _traceCount : TRACE_DEPTH;
+  uint16_t _i = (_traceCount < TRACE_DEPTH) ? 0 : _traceHead;
+  out.print("#FLASHTRACE ");
+  out.print(TRACE_FORMAT);
+  out.print(" jedec=");
+  out.print(getJEDECID(), HEX);
+  out.print(" recorded=");
+  out.print(_traceCount);
+  out.print(" entries=");
+  out.println(_n);
+  while (_n--) {
+    const FlashTraceEntry &_e = _trace[_i];
+    _printHexLE(out, _e.time, 4);
+    _printHexLE(out, _e.addr, 4);
+    _printHexLE(out, _e.len, 2);
+    _printHexLE(out, _e.duration, 2);
+    _printHexLE(out, _e.opcode, 1);
+    _printHexLE(out, _e.status, 1);
+    _printHexLE(out, _e.op, 1);
+    _printHexLE(out, _e.flags, 1);
+    out.println();
+    _i = (_i + 1) % TRACE_DEPTH;
+  }
+  out.println("#END");
+}
+
+//Empties the trace ring
+void SPIFlash::clearTrace() {
+  _traceHead = 0;
+  _traceCount = 0;
+  _traceOpen = false;
+}
+#endif
+
 //Returns the library version as three bytes
 bool SPIFlash::libver(uint8_t *b1, uint8_t *b2, uint8_t *b3) {
   *b1 = LIBVER;
@@ -174,6 +532,7 @@ uint64_t SPIFlash::getUniqueID() {
 // Takes the size of the data as an argument and returns a 32-bit address
 // All addresses in the in the sketch must be obtained via this function or not at all.
 uint32_t SPIFlash::getAddress(uint16_t size) {
+  FLASH_OP(STATS_CONTROL, 0)
   bool _loopedOver = false;
   if (!_addressCheck(currentAddress, size)){
     return false;
@@ -200,10 +559,11 @@ uint32_t SPIFlash::getAddress(uint16_t size) {
 }
 
 //Function for returning the size of the string (only to be used for the getAddress() function)
+//Strings are stored as a 16-bit length followed by the characters and the null terminator
 uint16_t SPIFlash::sizeofStr(String &inputStr) {
   uint16_t size;
   size = (sizeof(char)*(inputStr.length()+1));
-  size+=sizeof(inputStr.length()+1);
+  size+=sizeof(uint16_t);
 
 	return size;
 }
@@ -213,14 +573,8 @@ uint16_t SPIFlash::sizeofStr(String &inputStr) {
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 uint8_t SPIFlash::readByte(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   uint8_t data = 0;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -229,14 +583,8 @@ uint8_t SPIFlash::readByte(uint32_t _addr, bool fastRead) {
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 int8_t SPIFlash::readChar(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   int8_t data = 0;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -248,9 +596,7 @@ int8_t SPIFlash::readChar(uint32_t _addr, bool fastRead) {
 //    4. fastRead --> defaults to false - executes _beginFastRead() if set to true
 
 bool  SPIFlash::readByteArray(uint32_t _addr, uint8_t *data_buffer, size_t bufferSize, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_READ, bufferSize)
   if (!_prep(JEDEC_READ_DATA, _addr, bufferSize)) {
     return false;
   }
@@ -262,9 +608,6 @@ bool  SPIFlash::readByteArray(uint32_t _addr, uint8_t *data_buffer, size_t buffe
   }
   _nextBuf(JEDEC_READ_DATA, &(*data_buffer), bufferSize);
   _endSPI();
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
 	return true;
 }
 
@@ -275,9 +618,7 @@ bool  SPIFlash::readByteArray(uint32_t _addr, uint8_t *data_buffer, size_t buffe
 //    3. bufferSize --> The size of the buffer - in number of bytes.
 //    4. fastRead --> defaults to false - executes _beginFastRead() if set to true
 bool  SPIFlash::readCharArray(uint32_t _addr, char *data_buffer, size_t bufferSize, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_READ, bufferSize)
   if (!_prep(JEDEC_READ_DATA, _addr, bufferSize)) {
     return false;
 	}
@@ -289,25 +630,87 @@ bool  SPIFlash::readCharArray(uint32_t _addr, char *data_buffer, size_t bufferSi
   }
   _nextBuf(JEDEC_READ_DATA, (uint8_t*) &(*data_buffer), bufferSize);
   _endSPI();
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
 	return true;
 }
 
+// Reads a number of segments scattered across the flash memory with as few read instructions as possible.
+// Segments are read in order of address and segments that are adjacent, overlap or are separated by no more
+// than maxGap bytes are served by a single read instruction. The bytes in the gaps are clocked through and discarded.
+//  Takes four arguments
+//    1. v --> Array of segments to be read. Each segment holds an address, a buffer and the size of the buffer - in number of bytes
+//    2. n --> Number of segments in the array - at most IOVEC_MAX
+//    3. maxGap --> defaults to READV_MAXGAP - largest gap between two segments that is read through rather than starting a new read
+//    4. fastRead --> defaults to false - executes _beginFastRead() if set to true
+bool SPIFlash::readv(const FlashIOVec *v, size_t n, uint16_t maxGap, bool fastRead) {
+  FLASH_OP(STATS_READ, _iovecBytes(v, n))
+  if (!n) {
+    return true;
+  }
+  if (n > IOVEC_MAX) {
+    _troubleshoot(TOOMANYSEGMENTS);
+    return false;
+  }
+  uint16_t _order[IOVEC_MAX];
+  _sortIOVec(v, n, _order);
+
+  size_t i = 0;
+  while (i < n) {
+    // Work out how far the next read instruction can stretch
+    const FlashIOVec *_seg = &v[_order[i]];
+    uint32_t _runStart = _seg->addr;
+    uint32_t _runEnd = _seg->addr + _seg->len;
+    size_t _last = i + 1;
+    while (_last < n && v[_order[_last]].addr <= _runEnd + maxGap) {
+      if (v[_order[_last]].addr + v[_order[_last]].len > _runEnd) {
+        _runEnd = v[_order[_last]].addr + v[_order[_last]].len;
+      }
+      _last++;
+    }
+
+    if (!_prep(JEDEC_READ_DATA, _runStart, _runEnd - _runStart)) {
+      return false;
+    }
+    if(fastRead) {
+      _beginSPI(JEDEC_READ_FAST);
+    }
+    else {
+      _beginSPI(JEDEC_READ_DATA);
+    }
+    uint32_t _pos = _runStart;
+    const FlashIOVec *_tail = _seg;   // The segment that ends at _pos
+    for (; i < _last; i++) {
+      _seg = &v[_order[i]];
+      uint32_t _offset = 0;
+      if (_seg->addr < _pos) {
+        // The start of this segment has already been read into _tail - copy it from there
+        _offset = _pos - _seg->addr;
+        if (_offset > _seg->len) {
+          _offset = _seg->len;
+        }
+        memcpy(_seg->buffer, &_tail->buffer[_seg->addr - _tail->addr], _offset);
+      }
+      while (_pos < _seg->addr) {
+        _nextByte(READ);
+        _pos++;
+      }
+      if (_offset < _seg->len) {
+        _nextBuf(JEDEC_READ_DATA, &_seg->buffer[_offset], _seg->len - _offset);
+        _pos = _seg->addr + _seg->len;
+        _tail = _seg;
+      }
+    }
+    _endSPI();
+  }
+  return true;
+}
+
 // Reads an unsigned int of data from a specific location in a page.
 //  Takes two arguments -
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 uint16_t SPIFlash::readWord(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   uint16_t data;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -316,14 +719,8 @@ uint16_t SPIFlash::readWord(uint32_t _addr, bool fastRead) {
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 int16_t SPIFlash::readShort(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   int16_t data;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -332,14 +729,8 @@ int16_t SPIFlash::readShort(uint32_t _addr, bool fastRead) {
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 uint32_t SPIFlash::readULong(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   uint32_t data;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -348,14 +739,8 @@ uint32_t SPIFlash::readULong(uint32_t _addr, bool fastRead) {
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 int32_t SPIFlash::readLong(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   int32_t data;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -364,14 +749,8 @@ int32_t SPIFlash::readLong(uint32_t _addr, bool fastRead) {
 //    1. _addr --> Any address from 0 to capacity
 //    2. fastRead --> defaults to false - executes _beginFastRead() if set to true
 float SPIFlash::readFloat(uint32_t _addr, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
   float data;
   _read(_addr, data, sizeof(data), fastRead);
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
   return data;
 }
 
@@ -381,14 +760,28 @@ float SPIFlash::readFloat(uint32_t _addr, bool fastRead) {
 //    2. outputString --> String variable to write the output to
 //    3. fastRead --> defaults to false - executes _beginFastRead() if set to true
 bool SPIFlash::readStr(uint32_t _addr, String &data, bool fastRead) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-    bool _retVal = _read(_addr, data, sizeof(data), fastRead);
-    _spifuncruntime = micros() - _spifuncruntime;
-    return _retVal;
-  #else
-  return _read(_addr, data, sizeof(data), fastRead);
-  #endif
+  FLASH_OP(STATS_READ, 0)
+  uint16_t _sz;
+  if (!_read(_addr, _sz, sizeof(_sz), fastRead) || _sz == 0xFFFF || !_sz) {
+    return false;
+  }
+  FLASH_OPBYTES(_sz)
+  if (!_prep(JEDEC_READ_DATA, _addr + sizeof(_sz), _sz)) {
+    return false;
+  }
+  data = "";
+  data.reserve(_sz - 1);
+  if(fastRead) {
+    _beginSPI(JEDEC_READ_FAST);
+  }
+  else {
+    _beginSPI(JEDEC_READ_DATA);
+  }
+  for (uint16_t i = 0; i < _sz - 1; i++) {
+    data.concat((char)_nextByte(READ));
+  }
+  _endSPI();
+  return true;
 }
 
 // Writes a byte of data to a specific location in a page.
@@ -422,9 +815,7 @@ bool SPIFlash::writeChar(uint32_t _addr, int8_t data, bool errorCheck) {
 // WARNING: You can only write to previously erased memory locations (see datasheet).
 // Use the eraseSector()/eraseBlock32K/eraseBlock64K commands to first clear memory (write 0xFFs)
 bool SPIFlash::writeByteArray(uint32_t _addr, uint8_t *data_buffer, size_t bufferSize, bool errorCheck) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_WRITE, bufferSize)
   if (!_prep(JEDEC_PROG_BYTE, _addr, bufferSize)) {
     return false;
   }
@@ -470,9 +861,6 @@ bool SPIFlash::writeByteArray(uint32_t _addr, uint8_t *data_buffer, size_t buffe
 
   if (!errorCheck) {
     _endSPI();
-    #ifdef RUNDIAGNOSTIC
-      _spifuncruntime = micros() - _spifuncruntime;
-    #endif
     return true;
   }
   else {
@@ -485,13 +873,12 @@ bool SPIFlash::writeByteArray(uint32_t _addr, uint8_t *data_buffer, size_t buffe
     _transferAddress();
     for (uint16_t j = 0; j < bufferSize; j++) {
       if (_nextByte(READ) != data_buffer[j]) {
+        _troubleshoot(ERRORCHKFAIL);
+        _endSPI();
         return false;
       }
     }
     _endSPI();
-    #ifdef RUNDIAGNOSTIC
-      _spifuncruntime = micros() - _spifuncruntime;
-    #endif
     return true;
   }
 }
@@ -505,9 +892,7 @@ bool SPIFlash::writeByteArray(uint32_t _addr, uint8_t *data_buffer, size_t buffe
 // WARNING: You can only write to previously erased memory locations (see datasheet).
 // Use the eraseSector()/eraseBlock32K/eraseBlock64K commands to first clear memory (write 0xFFs)
 bool SPIFlash::writeCharArray(uint32_t _addr, char *data_buffer, size_t bufferSize, bool errorCheck) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_WRITE, bufferSize)
   if (!_prep(JEDEC_PROG_BYTE, _addr, bufferSize)) {
     return false;
   }
@@ -553,9 +938,6 @@ bool SPIFlash::writeCharArray(uint32_t _addr, char *data_buffer, size_t bufferSi
 
   if (!errorCheck) {
     _endSPI();
-    #ifdef RUNDIAGNOSTIC
-      _spifuncruntime = micros() - _spifuncruntime;
-    #endif
     return true;
   }
   else {
@@ -568,17 +950,205 @@ bool SPIFlash::writeCharArray(uint32_t _addr, char *data_buffer, size_t bufferSi
     _transferAddress();
     for (uint16_t j = 0; j < bufferSize; j++) {
       if (_nextByte(READ) != data_buffer[j]) {
+        _troubleshoot(ERRORCHKFAIL);
+        _endSPI();
         return false;
       }
     }
     _endSPI();
-    #ifdef RUNDIAGNOSTIC
-      _spifuncruntime = micros() - _spifuncruntime;
-    #endif
     return true;
   }
 }
 
+// Writes a number of segments - for example a record, its header and its index entry - in as few page programs as possible.
+// Segments are written in order of address and all segments that fall in the same page are packed into a single page program,
+// sharing one busy check, one check for previously written data and one write enable. Gaps between segments in a page are left untouched.
+//  Takes three arguments -
+//    1. v --> Array of segments to be written. Each segment holds an address, a buffer and the size of the buffer - in number of bytes
+//    2. n --> Number of segments in the array - at most IOVEC_MAX. Segments must not overlap
+//    3. errorCheck --> Turned on by default. Checks for writing errors
+// WARNING: You can only write to previously erased memory locations (see datasheet).
+// Use the eraseSector()/eraseBlock32K/eraseBlock64K commands to first clear memory (write 0xFFs)
+bool SPIFlash::writev(const FlashIOVec *v, size_t n, bool errorCheck) {
+  FLASH_OP(STATS_WRITE, _iovecBytes(v, n))
+  if (!n) {
+    return true;
+  }
+  if (n > IOVEC_MAX) {
+    _troubleshoot(TOOMANYSEGMENTS);
+    return false;
+  }
+  uint16_t _order[IOVEC_MAX];
+  _sortIOVec(v, n, _order);
+  for (size_t i = 1; i < n; i++) {
+    if (v[_order[i]].addr < v[_order[i - 1]].addr + v[_order[i - 1]].len) {
+      _troubleshoot(OVERLAPPINGSEGMENTS);
+      return false;
+    }
+  }
+  if (_chip.capacity && v[_order[n - 1]].addr + v[_order[n - 1]].len > _chip.capacity) {
+    _troubleshoot(VOYNICH_STATUS_OUTOFBOUNDS);
+    return false;
+  }
+
+  // The first pass programs the data page by page, the second reads it back if errorCheck is set
+  for (uint8_t _pass = 0; _pass < (errorCheck ? 2 : 1); _pass++) {
+    size_t i = 0;
+    uint32_t _offset = 0;
+    while (i < n) {
+      if (!v[_order[i]].len) {
+        i++;
+        continue;
+      }
+      // Find the part of the segment list that falls in the same page
+      uint32_t _spanStart = v[_order[i]].addr + _offset;
+      uint32_t _pageEnd = _spanStart - (_spanStart % SPI_PAGESIZE) + SPI_PAGESIZE;
+      uint32_t _spanEnd = _spanStart;
+      size_t _next = i;
+      uint32_t _nextOffset = _offset;
+      while (_next < n && v[_order[_next]].addr < _pageEnd) {
+        uint32_t _segEnd = v[_order[_next]].addr + v[_order[_next]].len;
+        if (_segEnd > _pageEnd) {
+          _spanEnd = _pageEnd;
+          _nextOffset = _pageEnd - v[_order[_next]].addr;
+          break;
+        }
+        if (_segEnd > _spanEnd) {
+          _spanEnd = _segEnd;
+        }
+        _next++;
+        _nextOffset = 0;
+      }
+
+      if (!_prep(PROGREADFUNC, _spanStart, _spanEnd - _spanStart)) {
+        return false;
+      }
+      if (!_pass) {
+      #ifndef HIGHSPEED
+        if (blankCheckEnabled) {
+          _beginSPI(JEDEC_READ_DATA);
+          if (!_iovecSpan(v, _order, n, i, _spanStart, _spanEnd, SPAN_BLANKCHECK)) {
+            _endSPI();
+            return false;
+          }
+        }
+      #endif
+        if (!_writeEnable()) {
+          _endSPI();
+          return false;
+        }
+        _beginSPI(JEDEC_PROG_BYTE);
+        _iovecSpan(v, _order, n, i, _spanStart, _spanEnd, SPAN_PROGRAM);
+      }
+      else {
+        _beginSPI(JEDEC_READ_DATA);
+        if (!_iovecSpan(v, _order, n, i, _spanStart, _spanEnd, SPAN_VERIFY)) {
+          _endSPI();
+          return false;
+        }
+      }
+      i = _next;
+      _offset = _nextOffset;
+    }
+  }
+  _endSPI();
+  return true;
+}
+
+// Copies a region of this flash memory to another location in the same chip. See copyTo()
+//  Takes five arguments -
+//    1. src --> Address of the region to be copied
+//    2. dst --> Address to copy the region to. The two regions must not overlap
+//    3. len --> Size of the region - in number of bytes
+//    4. eraseDst --> Erases the destination sectors before they are written to. Sectors that are only
+//       partly covered by the destination are never erased - those parts must be blank already
+//    5. errorCheck --> Turned on by default. Reads both regions back once the copy is complete and compares them
+bool SPIFlash::copyRegion(uint32_t src, uint32_t dst, uint32_t len, bool eraseDst, bool errorCheck) {
+  return copyTo(*this, src, dst, len, eraseDst, errorCheck);
+}
+
+// Copies a region of this flash memory to another flash memory - or to another location in this one - one page
+// at a time through a single page buffer. Once a page has been clocked out to the destination the next page is
+// read from the source while the destination is still programming, so when the two are different chips the
+// reads cost next to nothing. Source pages that are all 0xFF are not programmed at all.
+//  Takes six arguments -
+//    1. other --> The SPIFlash object to copy to. begin() must have been called on it first
+//    2. src --> Address of the region to be copied
+//    3. dst --> Address in the other flash memory to copy the region to
+//    4. len --> Size of the region - in number of bytes
+//    5. eraseDst --> Erases the destination sectors before they are written to. Sectors that are only
+//       partly covered by the destination are never erased - those parts must be blank already
+//    6. errorCheck --> Turned on by default. Reads both regions back once the copy is complete and compares them
+bool SPIFlash::copyTo(SPIFlash &other, uint32_t src, uint32_t dst, uint32_t len, bool eraseDst, bool errorCheck) {
+  FLASH_OP(STATS_WRITE, len)
+  if (!len) {
+    return true;
+  }
+  if (&other == this && src < dst + len && dst < src + len) {
+    _troubleshoot(OVERLAPPINGSEGMENTS);
+    return false;
+  }
+
+  uint8_t _buf[SPI_PAGESIZE];
+  uint32_t _done = 0, _erased = dst;
+  uint16_t _n = SPI_PAGESIZE - (dst % SPI_PAGESIZE);   // Pages are cut along the page boundaries of the destination
+  if (_n > len) {
+    _n = len;
+  }
+  if (!readByteArray(src, _buf, _n)) {
+    return false;
+  }
+  while (_n) {
+    uint32_t _d = dst + _done;
+    if (eraseDst && _d >= _erased && !(_d % KB(4)) && _d + KB(4) <= dst + len) {
+      // Erase whole 64KB blocks where they fit - erasing a block takes far less time than erasing its 16 sectors
+      if (!(_d % KB(64)) && _d + KB(64) <= dst + len) {
+        _erased = _d + KB(64);
+        if (!other.eraseBlock64K(_d)) {
+          return false;
+        }
+      }
+      else {
+        _erased = _d + KB(4);
+        if (!other.eraseSector(_d)) {
+          return false;
+        }
+      }
+    }
+    uint16_t i = 0;
+    while (i < _n && _buf[i] == 0xFF) {
+      i++;
+    }
+    if (i < _n && !other._pageProgram(_d, _buf, _n)) {
+      return false;
+    }
+    _done += _n;
+    _n = (len - _done > SPI_PAGESIZE) ? SPI_PAGESIZE : len - _done;
+    if (_n && !readByteArray(src + _done, _buf, _n)) {
+      return false;
+    }
+  }
+  if (!other._notBusy()) {
+    return false;
+  }
+
+  if (errorCheck) {
+    // Both halves of the page buffer are needed to compare the regions
+    const uint16_t _half = SPI_PAGESIZE / 2;
+    for (_done = 0; _done < len; _done += _n) {
+      _n = (len - _done > _half) ? _half : len - _done;
+      if (!readByteArray(src + _done, _buf, _n) || !other.readByteArray(dst + _done, &_buf[_half], _n)) {
+        return false;
+      }
+      if (memcmp(_buf, &_buf[_half], _n)) {
+        _troubleshoot(ERRORCHKFAIL);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 // Writes an unsigned int as two bytes starting from a specific location in a page.
 //  Takes three arguments -
 //    1. _addr --> Any address - from 0 to capacity
@@ -641,122 +1211,50 @@ bool SPIFlash::writeFloat(uint32_t _addr, float data, bool errorCheck) {
 //    3. errorCheck --> Turned on by default. Checks for writing errors
 // WARNING: You can only write to previously erased memory locations (see datasheet).
 // Use the eraseSector()/eraseBlock32K/eraseBlock64K commands to first clear memory (write 0xFFs)
+// The string is stored as a 16-bit length (including the null terminator) followed by its characters,
+// so sizeofStr() bytes must be available at _addr
 bool SPIFlash::writeStr(uint32_t _addr, String &data, bool errorCheck) {
-  return _write(_addr, data, sizeof(data), errorCheck, _STRING_);
+  FLASH_OP(STATS_WRITE, sizeofStr(data))
+  uint16_t _sz = data.length() + 1;
+  if (!_write(_addr, _sz, sizeof(_sz), errorCheck, _WORD_)) {
+    return false;
+  }
+  return writeCharArray(_addr + sizeof(_sz), (char*)data.c_str(), _sz, errorCheck);
 }
 
 // Erases a number of sectors or blocks as needed by the data being input.
 //  Takes an address and the size of the data being input as the arguments and erases the block/s of memory containing the address.
+// Runs the same commands as eraseSectionAsync() and waits for each of them - including any asynchronous job already in progress.
 bool SPIFlash::eraseSection(uint32_t _addr, uint32_t _sz) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
-
-  if (!_prep(ERASEFUNC, _addr, _sz)) {
+  FLASH_OP(STATS_ERASE, _sz)
+  FlashJob _erase;
+  waitJob();
+  if (!eraseSectionAsync(_addr, _sz, _erase)) {
     return false;
   }
-
-    // If size of data is > 4KB more than one sector needs to be erased. So the number of erase sessions is determined by the quotient of _sz/KB(4). If the _sz is not perfectly divisible by KB(4), then an additional sector has to be erased.
-  uint32_t noOfEraseRunsB4Boundary = 0;
-  uint32_t noOf4KBEraseRuns, KB64Blocks, KB32Blocks, KB4Blocks, totalBlocks;
-
-  if (_sz/KB(4)) {
-    noOf4KBEraseRuns = _sz/KB(4);
-  }
-  else {
-    noOf4KBEraseRuns = 1;
-  }
-  KB64Blocks = noOf4KBEraseRuns/16;
-  KB32Blocks = (noOf4KBEraseRuns % 16) / 8;
-  KB4Blocks = (noOf4KBEraseRuns % 8);
-  totalBlocks = KB64Blocks + KB32Blocks + KB4Blocks;
-
-  uint16_t _eraseFuncOrder[totalBlocks];
-
-  if (KB64Blocks) {
-    for (uint32_t i = 0; i < KB64Blocks; i++) {
-      _eraseFuncOrder[i] = JEDEC_ERASE_BLOCK_64;
-    }
-  }
-  if (KB32Blocks) {
-    for (uint32_t i = KB64Blocks; i < (KB64Blocks + KB32Blocks); i++) {
-      _eraseFuncOrder[i] = JEDEC_ERASE_BLOCK_32;
-    }
-  }
-  if (KB4Blocks) {
-    for (uint32_t i = (KB64Blocks + KB32Blocks); i < totalBlocks; i++) {
-      _eraseFuncOrder[i] = JEDEC_ERASE_SECTOR;
-    }
-  }
-
-// Now that the number of blocks to be erased have been calculated and the information saved, the erase function is carried out.
-  if (_addressOverflow) {
-    noOfEraseRunsB4Boundary = (_sz - _addressOverflow)/16;
-    noOfEraseRunsB4Boundary += ((_sz - _addressOverflow) % 16) / 8;
-    noOfEraseRunsB4Boundary += ((_sz - _addressOverflow) % 8);
-  }
-  if (!_addressOverflow) {
-    for (uint32_t j = 0; j < totalBlocks; j++) {
-      _beginSPI(_eraseFuncOrder[j]);   //The address is transferred as a part of this function
-      _endSPI();
-
-
-      //Serial.print("_eraseFuncOrder: 0x");
-      //Serial.println(_eraseFuncOrder[j], HEX);
-
-      uint16_t _timeFactor = 0;
-      switch (_eraseFuncOrder[j]) {
-        case JEDEC_ERASE_BLOCK_64:
-        _timeFactor = 1200;
-        break;
-
-        case JEDEC_ERASE_BLOCK_32:
-        _timeFactor = 1000;
-        break;
-
-        case JEDEC_ERASE_SECTOR:
-        _timeFactor = 500;
-        break;
-
-      }
-      if(!_notBusy(_timeFactor * 1000L)) {
-        return false;	//Datasheet says erasing a sector takes 400ms max
-      }
-      if (j == noOfEraseRunsB4Boundary) {
-        if (!_prep(ERASEFUNC, (_addr + (_sz - _addressOverflow)), _sz)) {
-          return false;
-        }
-        //Serial.print("Overflow triggered");
-      }
-    }
-  }
-  //_writeDisable();
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
-
-	return true;
+  return waitJob();
 }
 
 // Erases one 4k sector.
-//  Takes an address as the argument and erases the block containing the address.
-bool SPIFlash::eraseSector(uint32_t _addr) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+//  Takes two arguments -
+//    1. _addr --> Any address in the sector to be erased
+//    2. wait --> Turned on by default. If turned off the function returns as soon as the erase has started.
+//       The chip stays busy until it completes - check isBusy() before the next call to the library
+bool SPIFlash::eraseSector(uint32_t _addr, bool wait) {
+  FLASH_OP(STATS_ERASE, KB(4))
   if (!_prep(ERASEFUNC, _addr, KB(4))) {
     return false;
   }
   _beginSPI(JEDEC_ERASE_SECTOR);   //The address is transferred as a part of this function
   _endSPI();
 
-  if(!_notBusy(500 * 1000L)) {
-    return false;	//Datasheet says erasing a sector takes 400ms max
+  if (!wait) {
+    return true;
+  }
+  if(!_notBusy()) {
+    return false;
   }
   //_writeDisable();
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
 
 	return true;
 }
@@ -764,22 +1262,17 @@ bool SPIFlash::eraseSector(uint32_t _addr) {
 // Erases one 32k block.
 //  Takes an address as the argument and erases the block containing the address.
 bool SPIFlash::eraseBlock32K(uint32_t _addr) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_ERASE, KB(32))
   if (!_prep(ERASEFUNC, _addr, KB(32))) {
     return false;
   }
   _beginSPI(JEDEC_ERASE_BLOCK_32);
   _endSPI();
 
-  if(!_notBusy(1000 * 1000L)) {
-    return false;	//Datasheet says erasing a sector takes 400ms max
+  if(!_notBusy()) {
+    return false;
   }
   _writeDisable();
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
 
 	return true;
 }
@@ -787,9 +1280,7 @@ bool SPIFlash::eraseBlock32K(uint32_t _addr) {
 // Erases one 64k block.
 //  Takes an address as the argument and erases the block containing the address.
 bool SPIFlash::eraseBlock64K(uint32_t _addr) {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_ERASE, KB(64))
   if (!_prep(ERASEFUNC, _addr, KB(64))) {
     return false;
   }
@@ -797,20 +1288,15 @@ bool SPIFlash::eraseBlock64K(uint32_t _addr) {
   _beginSPI(JEDEC_ERASE_BLOCK_64);
   _endSPI();
 
-  if(!_notBusy(1200 * 1000L)) {
-    return false;	//Datasheet says erasing a sector takes 400ms max
+  if(!_notBusy()) {
+    return false;
   }
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
 	return true;
 }
 
 //Erases whole chip. Think twice before using.
 bool SPIFlash::eraseChip() {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_ERASE, _chip.capacity)
 	if(_isChipPoweredDown() || !_notBusy() || !_writeEnable()) {
     return false;
   }
@@ -818,16 +1304,114 @@ bool SPIFlash::eraseChip() {
 	_beginSPI(JEDEC_ERASE_CHIP);
   _endSPI();
 
-	while(_readStat1() & BUSY) {
-    //_delay_us(30000L);
+  // A chip erase takes tens of seconds - _notBusy() sleeps through most of it
+	return _notBusy();
+
+}
+
+// Starts erasing the sectors and blocks containing the section, and returns as soon as the first erase has been issued.
+// The section is erased one command at a time, using 64 KB and 32 KB block erases wherever they fit. Each call to
+// poll() issues the next command once the chip has finished the previous one. A section covering the whole chip is
+// erased with a single chip erase.
+//  Takes four arguments -
+//    1. _addr --> Any address in the first sector to be erased
+//    2. _sz --> Size of the section - in number of bytes
+//    3. job --> Tracks the progress of the erase. Must stay in scope until it completes
+//    4. callback --> Optional. Called from poll() when the erase completes or fails
+bool SPIFlash::eraseSectionAsync(uint32_t _addr, uint32_t _sz, FlashJob &job, FlashJobCallback callback) {
+  FLASH_OP(STATS_ERASE, _sz)
+  uint32_t _start = _addr - (_addr % KB(4));
+  uint32_t _end = _addr + (_sz ? _sz : 1);
+  if (_end % KB(4)) {
+    _end += KB(4) - (_end % KB(4));
   }
-  _endSPI();
+  return _startJob(job, ERASEFUNC, _start, _end - _start, NULL, false, callback);
+}
 
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
-	return true;
+// Starts erasing one 4k sector and returns without waiting for it to complete - see eraseSectionAsync()
+//  Takes three arguments -
+//    1. _addr --> Any address in the sector to be erased
+//    2. job --> Tracks the progress of the erase. Must stay in scope until it completes
+//    3. callback --> Optional. Called from poll() when the erase completes or fails
+bool SPIFlash::eraseSectorAsync(uint32_t _addr, FlashJob &job, FlashJobCallback callback) {
+  FLASH_OP(STATS_ERASE, KB(4))
+  return _startJob(job, ERASEFUNC, _addr - (_addr % KB(4)), KB(4), NULL, false, callback);
+}
+
+// Starts erasing one 32k block and returns without waiting for it to complete - see eraseSectionAsync()
+//  Takes three arguments -
+//    1. _addr --> Any address in the block to be erased
+//    2. job --> Tracks the progress of the erase. Must stay in scope until it completes
+//    3. callback --> Optional. Called from poll() when the erase completes or fails
+bool SPIFlash::eraseBlock32KAsync(uint32_t _addr, FlashJob &job, FlashJobCallback callback) {
+  FLASH_OP(STATS_ERASE, KB(32))
+  return _startJob(job, ERASEFUNC, _addr - (_addr % KB(32)), KB(32), NULL, false, callback);
+}
+
+// Starts erasing one 64k block and returns without waiting for it to complete - see eraseSectionAsync()
+//  Takes three arguments -
+//    1. _addr --> Any address in the block to be erased
+//    2. job --> Tracks the progress of the erase. Must stay in scope until it completes
+//    3. callback --> Optional. Called from poll() when the erase completes or fails
+bool SPIFlash::eraseBlock64KAsync(uint32_t _addr, FlashJob &job, FlashJobCallback callback) {
+  FLASH_OP(STATS_ERASE, KB(64))
+  return _startJob(job, ERASEFUNC, _addr - (_addr % KB(64)), KB(64), NULL, false, callback);
+}
+
+// Starts erasing the whole chip and returns without waiting for it to complete. A chip erase takes tens of seconds
+// on the larger parts - keep calling poll() from the main loop until it completes.
+//  Takes two arguments -
+//    1. job --> Tracks the progress of the erase. Must stay in scope until it completes
+//    2. callback --> Optional. Called from poll() when the erase completes or fails
+bool SPIFlash::eraseChipAsync(FlashJob &job, FlashJobCallback callback) {
+  FLASH_OP(STATS_ERASE, _chip.capacity)
+  return _startJob(job, ERASEFUNC, 0, _chip.capacity, NULL, false, callback);
+}
 
+// Starts writing an array of bytes and returns as soon as the first page program has been issued. Each call to
+// poll() programs the next page once the chip has finished the previous one.
+//  Takes six arguments -
+//    1. _addr --> Any address from 0 to capacity
+//    2. data_buffer --> The data to be written. Must stay unchanged until the write completes
+//    3. bufferSize --> Size of the data - in number of bytes
+//    4. job --> Tracks the progress of the write. Must stay in scope until it completes
+//    5. errorCheck --> Turned on by default. Reads each page back once it has been programmed
+//    6. callback --> Optional. Called from poll() when the write completes or fails
+// WARNING: You can only write to previously erased memory locations (see datasheet).
+bool SPIFlash::writeByteArrayAsync(uint32_t _addr, uint8_t *data_buffer, size_t bufferSize, FlashJob &job, bool errorCheck, FlashJobCallback callback) {
+  FLASH_OP(STATS_WRITE, bufferSize)
+  return _startJob(job, JEDEC_PROG_BYTE, _addr, bufferSize, data_buffer, errorCheck, callback);
+}
+
+// Moves the asynchronous erase or write in progress along. Call it regularly from the main loop. It returns at once while the
+// chip is busy - without touching the SPI bus until the command in progress is expected to be nearly complete - and
+// issues the next command once the chip is ready. The callback of the job, if any, is called from here when it completes.
+// If a time budget has been set (see setTimeBudget()) it keeps issuing commands for as long as the next one is expected
+// to be ready within the budget.
+// Returns JOB_BUSY while the job is running, JOB_DONE or JOB_ERROR from the call that completes it and JOB_IDLE when there is no job.
+uint8_t SPIFlash::poll() {
+  return _runJob(micros(), _timeBudget);
+}
+
+// Same as poll(), with a time budget that applies to this call only.
+//  Takes one argument -
+//    1. budget --> Longest time the call may spend waiting for the chip - in uS. 0 issues at most one command and never waits
+uint8_t SPIFlash::poll(uint32_t budget) {
+  return _runJob(micros(), budget);
+}
+
+// Blocks until the asynchronous erase or write in progress has completed. The wait between commands is the same as
+// that of the blocking functions. Returns false if the job failed.
+bool SPIFlash::waitJob() {
+  uint8_t _state = JOB_IDLE;
+  while (_job) {
+    if (!_notBusy()) {
+      _endJob(JOB_ERROR);
+      return false;
+    }
+    _state = poll();
+  }
+  return _state != JOB_ERROR;
 }
 
 //Suspends current Block Erase/Sector Erase/Page Program. Does not suspend chipErase().
@@ -835,63 +1419,44 @@ bool SPIFlash::eraseChip() {
 //Erase suspend is only allowed during Block/Sector erase.
 //Program suspend is only allowed during Page/Quad Page Program
 bool SPIFlash::suspendProg() {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
-	if(_isChipPoweredDown() || _notBusy()) {
+  FLASH_OP(STATS_CONTROL, 0)
+	if(_isChipPoweredDown() || !(_readStat1() & BUSY)) {
 		return false;
   }
 
-  if(!_noSuspend()) {
-    #ifdef RUNDIAGNOSTIC
-      _spifuncruntime = micros() - _spifuncruntime;
-    #endif
+  if(_isSuspended()) {
     return true;
   }
 
-  _beginSPI(JEDEC_SET_SUSPEND);
-  _endSPI();
-  _delay_us(20);
-  if(!_notBusy(50) || _noSuspend()) {
+  if (!_suspend()) {
+    _troubleshoot(SYSSUSPEND);
     return false;
   }
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
+  _endSPI();
   return true;
 }
 
 //Resumes previously suspended Block Erase/Sector Erase/Page Program.
 bool SPIFlash::resumeProg() {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
-	if(_isChipPoweredDown() || !_notBusy() || _noSuspend()) {
+  FLASH_OP(STATS_CONTROL, 0)
+	if(_isChipPoweredDown() || (_readStat1() & BUSY) || !_isSuspended()) {
     return false;
   }
 
-	_beginSPI(JEDEC_SET_RESUME);
-	_endSPI();
-
-	_delay_us(20);
-
-	if(_notBusy(10) || !_noSuspend()) {
+  _resume();
+  if (_isSuspended()) {
+    _troubleshoot(SYSSUSPEND);
     return false;
   }
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros() - _spifuncruntime;
-  #endif
+  _endSPI();
   return true;
-
 }
 
 //Puts device in low power state. Good for battery powered operations.
 //In powerDown() the chip will only respond to powerUp()
 bool SPIFlash::powerDown() {
+  FLASH_OP(STATS_CONTROL, 0)
   if (_chip.manufacturerID != MICROCHIP_MANID) {
-    #ifdef RUNDIAGNOSTIC
-      _spifuncruntime = micros();
-    #endif
   	if(!_notBusy(20))
   		return false;
 
@@ -900,15 +1465,8 @@ bool SPIFlash::powerDown() {
 
     _delay_us(5);
 
-    #ifdef RUNDIAGNOSTIC
-      chipPoweredDown = true;
-      bool _retVal = !_writeEnable(false);
-      _spifuncruntime = micros() - _spifuncruntime;
-      return _retVal;
-    #else
-      chipPoweredDown = true;
-      return !_writeEnable(false);
-    #endif
+    chipPoweredDown = true;
+    return !_writeEnable(false);
   }
   else {
     _troubleshoot(UNSUPPORTEDFUNC);
@@ -918,29 +1476,17 @@ bool SPIFlash::powerDown() {
 
 //Wakes chip from low power state.
 bool SPIFlash::powerUp() {
-  #ifdef RUNDIAGNOSTIC
-    _spifuncruntime = micros();
-  #endif
+  FLASH_OP(STATS_CONTROL, 0)
 	_beginSPI(JEDEC_SET_RELEASE);
   _endSPI();
 	_delay_us(3);						    //Max release enable time according to the Datasheet
 
-  #ifdef RUNDIAGNOSTIC
-    if (_writeEnable(false)) {
-      _writeDisable();
-      _spifuncruntime = micros() - _spifuncruntime;
-      chipPoweredDown = false;
-      return true;
-    }
-    return false;
-  #else
   if (_writeEnable(false)) {
     _writeDisable();
     chipPoweredDown = false;
     return true;
   }
   return false;
-  #endif
 }
 
 /* Note: _writeDisable() is not required at the end of any function that writes to the Flash memory because the Write Enable Latch (WEL) flag is cleared to 0 i.e. to write disable state upon the following conditions being completed:
@@ -28,12 +28,22 @@
 #ifndef SPIFLASH_H
 #define SPIFLASH_H
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
-//     Uncomment the code below to run a diagnostic if your flash 	  //
-//                         does not respond                           //
+//    Set the level of diagnostics below. Everything above the level  //
+//          chosen is compiled out of the library completely          //
 //                                                                    //
-//      Error codes will be generated and returned on functions       //
+//  FLASHLOG_NONE  --> Only the last error code - see error()         //
+//  FLASHLOG_ERROR --> Errors are also recorded in a RAM ring of      //
+//                     ERRORLOG_DEPTH entries - see printErrors()     //
+//  FLASHLOG_INFO  --> begin() also prints what it finds              //
+//  FLASHLOG_DEBUG --> Every error is also printed as it happens and  //
+//                     every function is timed - see functionRunTime()//
+//                                                                    //
+//   Uncomment RUNDIAGNOSTIC to run a diagnostic if your flash does   //
+//             not respond - the same as FLASHLOG_DEBUG               //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
-#define RUNDIAGNOSTIC                                               //
+#define FLASHLOGLEVEL FLASHLOG_ERROR                                  //
+#define ERRORLOG_DEPTH 8                                              //
+//#define RUNDIAGNOSTIC                                               //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
@@ -61,17 +71,53 @@
 //#define ENABLEZERODMA                                               //
 //#define ZERO_SPISERCOM SERCOM4                                      //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//   Uncomment the code below to collect per-operation statistics     //
+//   (calls, bytes, SPI transactions, busy polls, latency histogram)  //
+//                                                                    //
+//          Read them back with getStats() / printStats()             //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//#define ENABLESTATS                                                 //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//   Uncomment the code below to record every SPI transaction in a    //
+//    ring of TRACE_DEPTH entries (16 bytes of RAM each). Dump it     //
+//    with dumpTrace() and decode it with extras/host/flashtrace      //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+//#define ENABLETRACE                                                 //
+#define TRACE_DEPTH 64                                                //
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 #define PRINTNAMECHANGEALERT
 
 #include <Arduino.h>
 #include "defines.h"
 #include <SPI.h>
 
+#ifdef RUNDIAGNOSTIC
+#undef FLASHLOGLEVEL
+#define FLASHLOGLEVEL FLASHLOG_DEBUG
+#endif
+
 
 #define _delay_us(us) delayMicroseconds(us)
 
-#define CHIP_SELECT   digitalWrite(csPin, LOW);
-#define CHIP_DESELECT digitalWrite(csPin, HIGH);
+#ifdef ENABLESTATS
+#define STATS_SELECT    _stats.op[_curOp].transactions++;
+#else
+#define STATS_SELECT
+#endif
+#ifdef ENABLETRACE
+#define TRACE_SELECT    _traceSelect();
+#define TRACE_DESELECT  _traceDeselect();
+#else
+#define TRACE_SELECT
+#define TRACE_DESELECT
+#endif
+
+#define CHIP_SELECT   { STATS_SELECT TRACE_SELECT _opcodeNext = true; digitalWrite(csPin, LOW); }
+#define CHIP_DESELECT { digitalWrite(csPin, HIGH); _commandEnd(); TRACE_DESELECT }
 #define xfer(n)   SPI.transfer(n)
 #define BEGIN_SPI SPI.begin();
 
@@ -79,7 +125,108 @@
 #define LIBSUBVER 1
 #define BUGFIXVER 0
 
+// Describes one segment of a scatter-gather transfer - see readv() and writev()
+struct FlashIOVec {
+  uint32_t addr;        // Address of the first byte of the segment in the flash memory
+  uint8_t  *buffer;     // Buffer holding / receiving the data
+  size_t   len;         // Size of the segment - in number of bytes
+};
+
+struct FlashJob;
+// Called when an asynchronous erase or write completes - see poll()
+typedef void (*FlashJobCallback)(FlashJob &job);
+
+// Tracks an asynchronous erase or write from the call that starts it to its completion - see eraseSectorAsync() and poll().
+// The job (and the data of a write) must stay in scope and unchanged until its state is no longer JOB_BUSY.
+struct FlashJob {
+  uint8_t  state;       // JOB_IDLE, JOB_BUSY, JOB_DONE or JOB_ERROR
+  uint8_t  error;       // Error code - as returned by error() - once the state is JOB_ERROR
+  uint8_t  opcode;      // Erase command in progress, or JEDEC_PROG_BYTE for writes
+  bool     errorCheck;  // Writes only - each page is read back once it has been programmed
+  uint32_t addr;        // Address of the next command
+  uint32_t remaining;   // Bytes still to be erased / written once the command in progress completes
+  uint32_t step;        // Bytes erased / written by the command in progress
+  uint8_t  *buffer;     // Writes only - data for the next command
+  FlashJobCallback callback;
+  void     *arg;        // Free for use by the callback - never touched by the library
+};
+
+#ifdef ENABLESTATS
+// Statistics collected for one type of operation - see getStats()
+// All times are in microseconds. The mean run time is totalTime / calls.
+struct FlashOpStats {
+  uint32_t calls;       // Number of calls to public functions of this type
+  uint32_t errors;      // Number of calls that raised an error
+  uint32_t bytes;       // Number of bytes read / written / erased
+  uint32_t transactions;// Number of SPI transactions (chip selects)
+  uint32_t busyPolls;   // Number of status register reads while waiting for the chip
+  uint32_t busyTime;    // Time spent waiting for the chip
+  uint32_t totalTime;   // Total run time of all calls
+  uint32_t minTime;     // Shortest run time of a single call
+  uint32_t maxTime;     // Longest run time of a single call
+  uint32_t histogram[STATS_HISTBINS]; // Run times in log2 bins - bin n holds calls that took 2^(n-1) to 2^n - 1 uS
+};
+
+// Snapshot of the statistics for every type of operation - indexed by STATS_READ, STATS_WRITE, STATS_ERASE & STATS_CONTROL
+struct FlashStats {
+  uint32_t     since;   // micros() at the time the statistics were last reset
+  FlashOpStats op[STATS_OPTYPES];
+};
+#endif
+
+#if FLASHLOGLEVEL >= FLASHLOG_ERROR
+// One error recorded in the error log - see getError()
+struct FlashErrorEvent {
+  uint32_t time;        // micros() when the error was raised
+  uint32_t addr;        // Address the library was working on
+  uint8_t  code;        // Error code - as returned by error()
+  uint8_t  opcode;      // Opcode of the last SPI transaction before the error
+};
+#endif
+
+#ifdef ENABLETRACE
+// One SPI transaction recorded by the command tracer - see dumpTrace()
+struct FlashTraceEntry {
+  uint32_t time;        // micros() when the chip was selected
+  uint32_t addr;        // Address sent after the opcode - 0 if the opcode takes none
+  uint16_t len;         // Data bytes clocked after the opcode, address and dummy bytes - saturates at 65535
+  uint16_t duration;    // Time the chip stayed selected in uS - saturates at 65535
+  uint8_t  opcode;
+  uint8_t  status;      // First data byte read back - the register value for status register reads
+  uint8_t  op;          // Type of the public function that issued the transaction - STATS_READ etc.
+  uint8_t  flags;       // TRACE_4BYTE if the address was sent in 4-byte mode
+};
+#endif
+
+class SPIFlash;
+
+// Times a public function from start to return. Only the outermost scope counts, so
+// functions that call other public functions (eg. copyRegion()) are recorded once.
+class FlashOpScope {
+public:
+  FlashOpScope(SPIFlash *flash, uint8_t type, uint32_t bytes);
+  ~FlashOpScope();
+  uint32_t bytes;
+private:
+  SPIFlash *_flash;
+  uint32_t _start;
+  uint8_t  _type, _prevOp, _errors;
+  bool     _outer;
+};
+
+#if defined (ENABLESTATS)
+#define FLASH_OP(type, bytes) FlashOpScope _opScope(this, type, bytes);
+#define FLASH_OPBYTES(n)      _opScope.bytes += n;
+#elif (FLASHLOGLEVEL >= FLASHLOG_DEBUG) || defined (ENABLETRACE)
+#define FLASH_OP(type, bytes) FlashOpScope _opScope(this, type, 0);
+#define FLASH_OPBYTES(n)
+#else
+#define FLASH_OP(type, bytes)
+#define FLASH_OPBYTES(n)
+#endif
+
 class SPIFlash {
+  friend class FlashOpScope;
 public:
   //------------------------------------ Constructor ------------------------------------//
   //New Constructor to Accept the PinNames as a Chip select Parameter - @boseji <salearj@hotmail.com> 02.03.17
@@ -87,6 +234,14 @@ public:
   //----------------------------- Initial / Chip Functions ------------------------------//
   bool     begin(uint32_t flashChipSize = 0);
   void     setClock(uint32_t clockSpeed);
+  void     setFastReadClock(uint32_t clockSpeed);
+  uint32_t getClock();
+  uint32_t getFastReadClock();
+  bool     calibrate(uint32_t scratchAddr, uint32_t maxClock = CALIBRATE_MAXCLK);
+  void     setBlankCheck(bool enabled);
+  bool     getBlankCheck();
+  void     setSuspendBudget(uint32_t budget);
+  void     setTimeBudget(uint32_t budget);
   bool     libver(uint8_t *b1, uint8_t *b2, uint8_t *b3);
   uint8_t  error(bool verbosity = false);
   uint16_t getManID();
@@ -96,13 +251,36 @@ public:
   uint16_t sizeofStr(String &inputStr);
   uint32_t getCapacity();
   uint32_t getMaxPage();
+  bool     isBusy();
   float    functionRunTime();
+  #if FLASHLOGLEVEL >= FLASHLOG_ERROR
+  uint32_t errorsLogged();
+  bool     getError(uint8_t n, FlashErrorEvent &event);
+  void     clearErrors();
+  void     printErrors(Print &out);
+  #endif
+  #ifdef ENABLESTATS
+  const FlashStats &getStats();
+  void     resetStats();
+  void     printStats(Print &out);
+  #endif
+  #ifdef ENABLETRACE
+  void     dumpTrace(Print &out);
+  void     clearTrace();
+  #endif
   //-------------------------------- Write / Read Bytes ---------------------------------//
   bool     writeByte(uint32_t _addr, uint8_t data, bool errorCheck = true);
   uint8_t  readByte(uint32_t _addr, bool fastRead = false);
   //----------------------------- Write / Read Byte Arrays ------------------------------//
   bool     writeByteArray(uint32_t _addr, uint8_t *data_buffer, size_t bufferSize, bool errorCheck = true);
   bool     readByteArray(uint32_t _addr, uint8_t *data_buffer, size_t bufferSize, bool fastRead = false);
+  //------------------------------ Scatter-gather Reads --------------------------------//
+  bool     readv(const FlashIOVec *v, size_t n, uint16_t maxGap = READV_MAXGAP, bool fastRead = false);
+  //------------------------------ Scatter-gather Writes -------------------------------//
+  bool     writev(const FlashIOVec *v, size_t n, bool errorCheck = true);
+  //---------------------------------- Copy functions -----------------------------------//
+  bool     copyRegion(uint32_t src, uint32_t dst, uint32_t len, bool eraseDst = false, bool errorCheck = true);
+  bool     copyTo(SPIFlash &other, uint32_t src, uint32_t dst, uint32_t len, bool eraseDst = false, bool errorCheck = true);
   //-------------------------------- Write / Read Chars ---------------------------------//
   bool     writeChar(uint32_t _addr, int8_t data, bool errorCheck = true);
   int8_t   readChar(uint32_t _addr, bool fastRead = false);
@@ -133,10 +311,20 @@ public:
   template <class T> bool readAnything(uint32_t _addr, T& data, bool fastRead = false);
   //-------------------------------- Erase functions ------------------------------------//
   bool     eraseSection(uint32_t _addr, uint32_t _sz);
-  bool     eraseSector(uint32_t _addr);
+  bool     eraseSector(uint32_t _addr, bool wait = true);
   bool     eraseBlock32K(uint32_t _addr);
   bool     eraseBlock64K(uint32_t _addr);
   bool     eraseChip();
+  //---------------------------- Asynchronous erase / write -----------------------------//
+  bool     eraseSectionAsync(uint32_t _addr, uint32_t _sz, FlashJob &job, FlashJobCallback callback = NULL);
+  bool     eraseSectorAsync(uint32_t _addr, FlashJob &job, FlashJobCallback callback = NULL);
+  bool     eraseBlock32KAsync(uint32_t _addr, FlashJob &job, FlashJobCallback callback = NULL);
+  bool     eraseBlock64KAsync(uint32_t _addr, FlashJob &job, FlashJobCallback callback = NULL);
+  bool     eraseChipAsync(FlashJob &job, FlashJobCallback callback = NULL);
+  bool     writeByteArrayAsync(uint32_t _addr, uint8_t *data_buffer, size_t bufferSize, FlashJob &job, bool errorCheck = true, FlashJobCallback callback = NULL);
+  uint8_t  poll();
+  uint8_t  poll(uint32_t budget);
+  bool     waitJob();
   //-------------------------------- Power functions ------------------------------------//
   bool     suspendProg();
   bool     resumeProg();
@@ -147,16 +335,35 @@ public:
 private:
   //------------------------------- Private functions -----------------------------------//
   void     _troubleshoot(uint8_t _code, bool printoverride = false);
+  #if FLASHLOGLEVEL >= FLASHLOG_ERROR
+  void     _logError(uint8_t _code);
+  #endif
   void     _printErrorCode();
   void     _printSupportLink();
   void     _endSPI();
   bool     _disableGlobalBlockProtect();
   bool     _isChipPoweredDown();
   bool     _prep(uint8_t opcode, uint32_t _addr, uint32_t size = 0);
-  bool     _startSPIBus();
+  bool     _startSPIBus(bool fast = false);
   bool     _beginSPI(uint8_t opcode);
-  bool     _noSuspend();
+  bool     _isSuspended();
+  bool     _canSuspend();
+  bool     _suspend();
+  void     _resume();
+  bool     _suspendForRead(uint32_t _addr, uint32_t size);
   bool     _notBusy(uint32_t timeout = BUSY_TIMEOUT);
+  void     _commandEnd();
+  void     _sleep(uint32_t us);
+  bool     _readSFDP(uint32_t _addr, uint8_t *data_buffer, uint8_t size);
+  bool     _getSFDPTimes();
+  uint8_t  _calPattern(uint16_t i);
+  bool     _calWrite(uint32_t _addr);
+  bool     _calCheck(uint32_t _addr, uint8_t opcode, uint32_t clock);
+  bool     _startJob(FlashJob &job, uint8_t opcode, uint32_t _addr, uint32_t size, uint8_t *buffer, bool errorCheck, FlashJobCallback callback);
+  bool     _issueJobCommand();
+  uint8_t  _endJob(uint8_t state);
+  uint8_t  _advanceJob();
+  uint8_t  _runJob(uint32_t start, uint32_t budget, bool stepped = false);
   bool     _notPrevWritten(uint32_t _addr, uint32_t size = 1);
   bool     _writeEnable(bool _troubleshootEnable = true);
   bool     _writeDisable();
@@ -166,6 +373,9 @@ private:
   bool     _chipID();
   bool     _transferAddress();
   bool     _addressCheck(uint32_t _addr, uint32_t size = 1);
+  void     _sortIOVec(const FlashIOVec *v, size_t n, uint16_t *order);
+  bool     _iovecSpan(const FlashIOVec *v, const uint16_t *order, size_t n, size_t i, uint32_t spanStart, uint32_t spanEnd, uint8_t mode);
+  bool     _pageProgram(uint32_t _addr, uint8_t *data_buffer, uint16_t size);
   bool     _enable4ByteAddressing();
   bool     _disable4ByteAddressing();
   uint8_t  _nextByte(char IOType, uint8_t data = NULLBYTE);
@@ -174,14 +384,26 @@ private:
   uint8_t  _readStat1();
   uint8_t  _readStat2();
   uint8_t  _readStat3();
+  #ifdef ENABLESTATS
+  uint32_t _iovecBytes(const FlashIOVec *v, size_t n);
+  void     _countBusyWait(uint32_t start, uint32_t polls);
+  #endif
+  #ifdef ENABLETRACE
+  void     _traceSelect();
+  void     _traceDeselect();
+  void     _traceByte(uint8_t out, uint8_t in);
+  void     _traceData(uint32_t size, const uint8_t *in = NULL);
+  #endif
   template <class T> bool _write(uint32_t _addr, const T& value, uint32_t _sz, bool errorCheck, uint8_t _dataType);
   template <class T> bool _read(uint32_t _addr, T& value, uint32_t _sz, bool fastRead = false, uint8_t _dataType = 0x00);
   //template <class T> bool _writeErrorCheck(uint32_t _addr, const T& value);
   template <class T> bool _writeErrorCheck(uint32_t _addr, const T& value, uint32_t _sz, uint8_t _dataType = 0x00);
   //-------------------------------- Private variables ----------------------------------//
   #ifdef SPI_HAS_TRANSACTION
-    SPISettings _settings;
+    SPISettings _settings, _fastSettings;  // Clock profiles for JEDEC_READ_FAST and for every other command
   #endif
+  uint32_t    _clock = SPI_CLK, _fastClock = SPI_CLK;
+  bool        _busFast = false;           // The bus was started with _fastSettings
   //If multiple SPI ports are available this variable is used to choose between them (SPI, SPI1, SPI2 etc.)
   SPIClass *_spi;
   #if !defined (BOARD_RTL8195A)
@@ -191,13 +413,49 @@ private:
   gpio_t      csPin;
   #endif
   volatile uint8_t *cs_port;
-  bool        pageOverflow, SPIBusState;
+  bool        pageOverflow, SPIBusState = false;
   bool        chipPoweredDown = false;
   bool        address4ByteEnabled = false;
+  bool        blankCheckEnabled = true;
   uint8_t     cs_mask, errorcode, stat1, stat2, stat3, _SPCR, _SPSR, _a0, _a1, _a2;
   char READ = 'R';
   char WRITE = 'W';
   float _spifuncruntime = 0;
+  uint8_t     _statsDepth = 0;
+  #if FLASHLOGLEVEL >= FLASHLOG_ERROR
+  FlashErrorEvent _errorLog[ERRORLOG_DEPTH];
+  uint32_t    _errorCount = 0;
+  uint8_t     _lastOpcode = 0;
+  #endif
+  // Opcode of the transaction in progress, and the program or erase the chip is busy with - see _notBusy()
+  bool        _opcodeNext = false;
+  uint8_t     _cmdOpcode = 0;
+  uint8_t     _busyOp = BUSY_NONE, _busySuspended = BUSY_NONE;
+  uint32_t    _busyStart = 0;
+  uint32_t    _busyAddr = 0, _busySize = 0;                 // Memory the last program or erase worked on
+  uint32_t    _busyTyp[BUSY_OPTYPES] = {0, 0, 0, 0, 0};     // Running estimate of the time each takes - 0 until one has been seen
+  uint32_t    _busyMax[BUSY_OPTYPES] = {BUSY_MAX_PROG, BUSY_MAX_SE, BUSY_MAX_BE32, BUSY_MAX_BE64, BUSY_MAX_CE};
+  // Program or erase suspended to serve a read - see _suspendForRead()
+  bool        _autoSuspended = false;
+  uint32_t    _suspendStart = 0, _resumeTime = 0, _suspendedFor = 0;
+  uint32_t    _suspendBudget = SUSPEND_BUDGET;
+  // Asynchronous erase or write in progress - see poll()
+  FlashJob    *_job = NULL;
+  uint32_t    _timeBudget = 0;
+  uint32_t    _jobCost = 0;                 // Longest step of a job seen at the current clock - in uS
+  #if defined (ENABLESTATS) || defined (ENABLETRACE)
+  uint8_t     _curOp = STATS_CONTROL;
+  #endif
+  #ifdef ENABLESTATS
+  FlashStats  _stats;
+  uint8_t     _statsErrors = 0;
+  #endif
+  #ifdef ENABLETRACE
+  FlashTraceEntry _trace[TRACE_DEPTH];
+  uint16_t    _traceHead = 0;
+  uint32_t    _traceCount = 0, _traceBytes = 0;
+  bool        _traceOpen = false;
+  #endif
   struct      chipID {
                 bool supported;
                 uint8_t manufacturerID;
@@ -207,8 +465,8 @@ private:
                 uint32_t capacity;
                 uint32_t eraseTime;
               };
-              chipID _chip;
-  uint32_t    currentAddress, _currentAddress = 0;
+              chipID _chip = {false, 0, 0, 0, 0, 0, 0};
+  uint32_t    currentAddress = 0, _currentAddress = 0;
   uint32_t    _addressOverflow = false;
   uint8_t _uniqueID[8];
   const uint8_t _capID[14]   =
@@ -288,10 +546,8 @@ template <class T> bool SPIFlash::_writeErrorCheck(uint32_t _addr, const T& valu
 //      Use the eraseSector()/eraseBlock32K/eraseBlock64K commands to first clear memory (write 0xFFs)
 
 template <class T> bool SPIFlash::_write(uint32_t _addr, const T& value, uint32_t _sz, bool errorCheck, uint8_t _dataType) {
+  FLASH_OP(STATS_WRITE, _sz)
   bool _retVal;
-#ifdef RUNDIAGNOSTIC
-  _spifuncruntime = micros();
-#endif
 
   uint32_t _addrIn = _addr;
   if (!_prep(JEDEC_PROG_BYTE, _addrIn, _sz)) {
@@ -357,9 +613,6 @@ template <class T> bool SPIFlash::_write(uint32_t _addr, const T& value, uint32_
   else {
     _retVal =  _writeErrorCheck(_addr, value, _sz, _dataType);
   }
-#ifdef RUNDIAGNOSTIC
-  _spifuncruntime = micros() - _spifuncruntime;
-#endif
   return _retVal;
 }
 
@@ -370,6 +623,7 @@ template <class T> bool SPIFlash::_write(uint32_t _addr, const T& value, uint32_
 //  3. _sz --> Size of the variable in bytes (1 byte = 8 bits)
 //  4. fastRead --> defaults to false - executes _beginFastRead() if set to true
 template <class T> bool SPIFlash::_read(uint32_t _addr, T& value, uint32_t _sz, bool fastRead, uint8_t _dataType) {
+  FLASH_OP(STATS_READ, _sz)
   if (!_prep(JEDEC_READ_DATA, _addr, _sz)) {
     return false;
   }
@@ -389,11 +643,13 @@ template <class T> bool SPIFlash::_read(uint32_t _addr, T& value, uint32_t _sz,
       CHIP_SELECT
       if (fastRead) {
         _nextByte(WRITE, JEDEC_READ_FAST);
+        _transferAddress();
+        _nextByte(WRITE, DUMMYBYTE);
       }
       else {
         _nextByte(WRITE, JEDEC_READ_DATA);
+        _transferAddress();
       }
-      _transferAddress();
       for (uint16_t i = 0; i < _sz; i++) {
         *p++ =_nextByte(READ);
       }
@@ -56,6 +56,8 @@
 // Misc
 #define SPI_PAGESIZE  256
 #define SPI_WRITE_DELAY   0x02
+#define READV_MAXGAP  32          // Gaps of up to this many bytes between segments are read through rather than starting a new read
+#define IOVEC_MAX     32          // Most segments readv() and writev() take in one call - each costs two bytes of stack
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 //                     General size definitions                       //
@@ -78,6 +80,8 @@
   #define MICROCHIP_SST25       0x25
   #define MICROCHIP_SST26       0x26
   #define ULBPR                 0x98    //Global Block Protection Unlock (Ref sections 4.1.1 & 5.37 of datasheet)
+  #define MICROCHIP_SET_SUSPEND 0xB0    //SST26 Write-Suspend / Write-Resume. Other parts use JEDEC_SET_SUSPEND / JEDEC_SET_RESUME
+  #define MICROCHIP_SET_RESUME  0x30
 
 //~~~~~~~~~~~~~~~~~~~~~~~~ Cypress ~~~~~~~~~~~~~~~~~~~~~~~~//
   #define CYPRESS_MANID         0x01
@@ -93,6 +97,9 @@
 
 #define BUSY          0x01
 #define SPI_CLK       20000000        //Hz equivalent of 20MHz
+#define CALIBRATE_MAXCLK  133000000L  // Highest clock calibrate() tries - in Hz
+#define CALIBRATE_STEP    4           // calibrate() raises the clock by 1/CALIBRATE_STEP at a time
+#define CALIBRATE_MARGIN  10          // Percentage calibrate() takes off the highest clock that passed
 #define WRTEN         0x02
 #define SUS           0x80
 #define WSE           0x04
@@ -107,8 +114,12 @@
 #define NOOVERFLOW    false
 #define NOERRCHK      false
 #define VERBOSE       true
+#define SPAN_BLANKCHECK 0x01
+#define SPAN_PROGRAM    0x02
+#define SPAN_VERIFY     0x03
 #define PRINTOVERRIDE true
 #define ERASEFUNC     0xEF
+#define PROGREADFUNC  0xED            // Reads made on the way to a program - they wait for the chip rather than suspend it
 #if defined (SIMBLEE)
 #define BUSY_TIMEOUT  100L
 #elif defined ENABLEZERODMA
@@ -116,6 +127,23 @@
 #else
 #define BUSY_TIMEOUT  1000L
 #endif
+#define BUSY_NONE     0xFF            // Programs and erases tracked by _notBusy() - see _busyTyp[] / _busyMax[]
+#define BUSY_PROG     0x00
+#define BUSY_SE       0x01
+#define BUSY_BE32     0x02
+#define BUSY_BE64     0x03
+#define BUSY_CE       0x04
+#define BUSY_OPTYPES  0x05
+#define BUSY_MAX_PROG 5000L           // Longest time (uS) each can take, used when the chip has no SFDP timing table.
+#define BUSY_MAX_SE   500000L         // Datasheet maxima of the slowest supported parts, with some margin
+#define BUSY_MAX_BE32 1600000L
+#define BUSY_MAX_BE64 2000000L
+#define BUSY_MAX_CE   400000000L
+#define BUSY_EARLY    8               // Polling starts 1/BUSY_EARLY of the expected time before a program or erase should complete
+#define BUSY_POLLMIN  10L             // Shortest interval between status polls - in uS. Doubles after every poll
+#define SUSPEND_TSUS  50L             // Longest time (uS) the chip takes to suspend a program or erase (tSUS is 10 - 30 uS)
+#define SUSPEND_TRS   100L            // Time (uS) a resumed program or erase runs before it is suspended again, so that it makes progress
+#define SUSPEND_BUDGET 100000L        // Default for setSuspendBudget()
 #define arrayLen(x)   (sizeof(x) / sizeof(*x))
 #define lengthOf(x)   (sizeof(x))/sizeof(byte)
 #define BYTE          1L
@@ -149,6 +177,10 @@
 #define UNABLETO4BYTE        0x0D
 #define UNABLETO3BYTE        0x0E
 #define CHIPISPOWEREDDOWN    0x0F
+#define OVERLAPPINGSEGMENTS  0x10
+#define JOBRUNNING           0x11
+#define CALIBRATIONFAIL      0x12
+#define TOOMANYSEGMENTS      0x13
 #define UNKNOWNERROR         0xFE
 
  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
@@ -167,6 +199,34 @@
 #define _CHARARRAY_         0x0A
 #define _STRUCT_            0x0B
 
+ //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+ //              Statistics, tracing and diagnostics                   //
+ //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#define STATS_READ          0x00
+#define STATS_WRITE         0x01
+#define STATS_ERASE         0x02
+#define STATS_CONTROL       0x03      // Power, suspend / resume and anything outside a public function
+#define STATS_OPTYPES       0x04
+#define STATS_HISTBINS      16
+
+#define FLASHLOG_NONE       0         // Diagnostic levels - see FLASHLOGLEVEL in SPIFlash.h
+#define FLASHLOG_ERROR      1
+#define FLASHLOG_INFO       2
+#define FLASHLOG_DEBUG      3
+
+#define TRACE_4BYTE         0x01      // Flag - the address of a traced transaction was sent in 4-byte mode
+#define TRACE_FORMAT        1         // Version of the format written by dumpTrace()
+
+ //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+ //                 States of an asynchronous job                      //
+ //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#define JOB_IDLE            0x00      // No job has been started / poll() has nothing to do
+#define JOB_BUSY            0x01
+#define JOB_DONE            0x02
+#define JOB_ERROR           0x03
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 //                        Bit shift macros                            //
 //                      Thanks to @VitorBoss                          //
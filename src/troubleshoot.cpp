@@ -40,11 +40,32 @@ void SPIFlash::_printSupportLink() {
   Serial.print("If this does not help resolve/clarify this issue, ");
   Serial.println("please raise an issue at http://www.github.com/Marzogh/SPIFlash/issues with the details of what your were doing when this error occurred");
 }
-//Troubleshooting function. Called when #ifdef RUNDIAGNOSTIC is uncommented at the top of this file.
+#if FLASHLOGLEVEL >= FLASHLOG_ERROR
+//Adds an error to the error log, overwriting the oldest one once the log is full
+void SPIFlash::_logError(uint8_t _code) {
+  FlashErrorEvent &_e = _errorLog[_errorCount % ERRORLOG_DEPTH];
+  _e.time = micros();
+  _e.addr = _currentAddress;
+  _e.code = _code;
+  _e.opcode = _lastOpcode;
+  _errorCount++;
+}
+#endif
+
+//Troubleshooting function. Records the error code and - if FLASHLOGLEVEL is FLASHLOG_DEBUG or an error
+//message has been asked for with error(VERBOSE) - prints an explanation of it.
 void SPIFlash::_troubleshoot(uint8_t _code, bool printoverride) {
   bool _printoverride;
   errorcode = _code;
-#ifdef RUNDIAGNOSTIC
+  if (!printoverride) {
+  #ifdef ENABLESTATS
+    _statsErrors++;
+  #endif
+  #if FLASHLOGLEVEL >= FLASHLOG_ERROR
+    _logError(_code);
+  #endif
+  }
+#if FLASHLOGLEVEL >= FLASHLOG_DEBUG
   _printoverride = true;
 #else
   _printoverride = printoverride;
@@ -130,6 +151,22 @@ void SPIFlash::_troubleshoot(uint8_t _code, bool printoverride) {
       Serial.println("The Flash chip is currently powered down.");
       break;
 
+      case OVERLAPPINGSEGMENTS:
+      Serial.println("The regions passed to writev() or copyRegion() overlap.");
+      break;
+
+      case JOBRUNNING:
+      Serial.println("An asynchronous erase or write is still running. Call poll() or waitJob() until it completes.");
+      break;
+
+      case CALIBRATIONFAIL:
+      Serial.println("The calibration pattern could not be written to and read back from the scratch sector.");
+      break;
+
+      case TOOMANYSEGMENTS:
+      Serial.println("More segments were passed to readv() or writev() than IOVEC_MAX.");
+      break;
+
       default:
       Serial.println("Unknown error");
       break;